@@ -6,12 +6,14 @@
     	.globl	_ckintr
     	.globl	_dlrintr
     	.globl	_dlxintr
+    	.globl	_rlintr
     	.globl	_cksec	# External C subroutine
     	.globl	_ckint	# External C subroutine
     	.globl	_cktick	# External unsigned int in the C code
     	.globl	_spnow	# External unsigned int in the C code
     	.globl	_rcvintr	# External C subroutine
     	.globl	_xmtintr	# External C subroutine
+    	.globl	_rlint	# External C subroutine
 
 #############################################################################*
 ##### _start: initialize stack pointer,
@@ -35,6 +37,8 @@ L_0:
 	mov	$000200,*$000066   # SP = 00200 BR4 Priority=4
         mov	$_ckintr,*$000100  # Vector 100 -> ckintr
         mov	$000300,*$000102   # SP = 00300
+	mov	$_rlintr,*$000160  # Vector 160 -> rlintr
+	mov	$000240,*$000162   # SP = 00240 BR5 Priority=5
 	mov	$0177546,r1	# CLK SR
 	mov	$0000100,(r1)   # Enable CLK interrupts
 	mov	$0177560,r1	# DL11 CSR
@@ -99,3 +103,19 @@ _dlxintr:
 	mov	(sp)+, r1      # Pop R1
 	mov	(sp)+, r0      # Pop R0
 	rti
+
+_rlintr:
+	mov	r0, -(sp)      # Push R0
+	mov	r1, -(sp)      # Push R1
+	mov	r2, -(sp)      # Push R2
+	mov	r3, -(sp)      # Push R3
+	mov	r4, -(sp)      # Push R4
+	mov	r5, -(sp)      # Push R5
+	jsr	pc,_rlint
+	mov	(sp)+, r5      # Pop R5
+	mov	(sp)+, r4      # Pop R4
+	mov	(sp)+, r3      # Pop R3
+	mov	(sp)+, r2      # Pop R2
+	mov	(sp)+, r1      # Pop R1
+	mov	(sp)+, r0      # Pop R0
+	rti
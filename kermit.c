@@ -1061,8 +1061,8 @@ spar(struct k_data * k, UCHAR *s, int datalen) {
 	} else if (s[7] == 'Y' && k->parity) {
 	    k->ebqflg = 1;
 	    k->ebq = '&';
-	} else if (s[7] == 'N') {
-	    /* WHAT? */
+	} else if (s[7] == 'N') {	/* Refused, 8-bit data goes as is */
+	    k->ebqflg = 0;
 	}
     }
     if (datalen >= 8) {                 /* Block check */
@@ -1242,7 +1242,7 @@ decode(struct k_data * k, struct k_response * r, short f, UCHAR *inbuf) {
             a = *inbuf++ & 0xFF;        /* and get the prefixed character. */
         }
         b8 = 0;                         /* 8th-bit value */
-        if (k->parity && (a == k->ebq)) { /* Have 8th-bit prefix? */
+        if (k->ebqflg && (a == k->ebq)) { /* Have 8th-bit prefix? */
             b8 = 0200;                  /* Yes, flag the 8th bit */
             a = *inbuf++ & 0x7F;        /* and get the prefixed character. */
         }
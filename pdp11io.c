@@ -85,12 +85,21 @@ extern volatile unsigned long cksec_cnt;
 static volatile unsigned int rl_drive_selected = 0;
 static volatile RLDSK * rlst_ptr;
 
+#if defined(RLBADMAP) || defined(RLINCR) || defined(RLDEDUP) || defined(RLAMAP) || \
+    defined(RLV7GET)
+#define TXTFILES			/* Some files are text made up here */
+#endif
+
 extern void cons_num(char* s,unsigned int x);
 extern void cons_hex(char* s,unsigned int x, int ascfg);
 
 
 UCHAR o_buf[OBUFLEN+8];			/* File output buffer */
+#ifdef BINARYSAFE
+UCHAR i_buf[8];				/* readfile() hands out track buffers */
+#else /* BINARYSAFE */
 UCHAR i_buf[IBUFLEN+8];			/* File output buffer */
+#endif /* BINARYSAFE */
 
 
 #ifndef NODLINTR
@@ -187,17 +196,110 @@ static char base64_tbl[] = {'A', 'B', 'C', 'D', 'E', 'F', 'G', 'H',
 
 static char base64_ibuf[4];
 static char base64_obuf[5];
-static int base64_idx=(-1);
+static int base64_idx=(-1);		/* Next char of base64_obuf, -1 none */
+static char *base64_src;		/* Input bytes, in the track buffer */
+static int base64_scnt=0;		/* Input bytes left at base64_src */
+
+/* The first and last char of a group each come from one byte, so they are
+   looked up by the byte itself and need no shift at all. */
+static char base64_hi[256];		/* base64_tbl[c >> 2] */
+static char base64_lo[256];		/* base64_tbl[c & 077] */
+
+static void
+base64_mk()
+{  int c;
+   for(c=0;c<256;c++) {
+      base64_hi[c] = base64_tbl[c >> 2];
+      base64_lo[c] = base64_tbl[c & 077];
+   }
+}
+
+/* Encode n whole groups of 3 bytes into 4 chars each. The two middle chars
+   straddle a byte boundary and come from one 16-bit word shift of the byte
+   pair, nothing wider than an int is ever used. */
+static char *
+base64_grp(char *dp, UCHAR *sp, int n)
+{  unsigned int w;
+   while( n-- > 0 ) {
+      dp[0] = base64_hi[sp[0]];
+      w = ((unsigned int)sp[0] << 8) | sp[1];
+      dp[1] = base64_tbl[(w >> 4) & 077];
+      w = ((unsigned int)sp[1] << 8) | sp[2];
+      dp[2] = base64_tbl[(w >> 6) & 077];
+      dp[3] = base64_lo[sp[2]];
+      sp += 3;
+      dp += 4;
+   }
+   return(dp);
+}
+
+/* Fill buf with up to len chars. Whole groups are encoded straight out of
+   the track buffer, as many as both the buffer piece and the packet hold.
+   Only a group split across two pieces, or one that does not fit in what
+   is left of the packet, goes through base64_obuf. A short last group is
+   padded with '=' so the decoded image comes out at its exact length. */
 int
 base64_enc(char *buf, int len)
+{  char *dp=buf, *end=buf+len;
+   int n, j;
+   if( base64_hi[0] == 0 ) { base64_mk(); } /* 'A', never 0 once built */
+   while( dp < end ) {
+      if( base64_idx >= 0 ) {		/* Rest of a group from last time */
+         *dp++ = base64_obuf[base64_idx++];
+         if( base64_idx > 3 ) { base64_idx = -1; }
+         continue;
+      }
+      if( base64_scnt < 1 ) {
+         base64_scnt = rl_sread_map(&base64_src, 0x7FFF);
+         if( base64_scnt < 1 ) { break; } /* EOF */
+      }
+      n = (int)(end - dp) >> 2;		/* Groups the packet has room for */
+      j = base64_scnt / 3;		/* Groups in this piece */
+      if( n > j ) { n = j; }
+      if( n > 0 ) {
+         dp = base64_grp(dp, (UCHAR *)base64_src, n);
+         n += n + n;
+         base64_src += n;
+         base64_scnt -= n;
+         continue;
+      }
+      for(j=0;j<3;j++) {		/* One group through base64_obuf */
+         if( base64_scnt < 1 ) {
+            base64_scnt = rl_sread_map(&base64_src, 0x7FFF);
+            if( base64_scnt < 1 ) { break; } /* EOF */
+         }
+         base64_ibuf[j] = *base64_src++;
+         base64_scnt--;
+      }
+      if( j == 0 ) { break; }
+      for(n=j;n<3;n++)base64_ibuf[n]=0;
+      base64_grp(base64_obuf, (UCHAR *)base64_ibuf, 1);
+      for(n=j+1;n<4;n++)base64_obuf[n]='='; /* Short last group */
+      base64_idx = 0;
+   }
+   return((int)(dp - buf));
+}
+
+#ifdef RLBENCH
+/* The unsigned long encoder base64_enc() replaced, kept to compare timings.
+   Its short last group is not padded. */
+static int
+base64_enc_long(char *buf, int len)
 {  int ocnt=0;
-   int j, rcnt;
+   int j;
    unsigned long x;
    while( ocnt < len ) {
       if( base64_idx < 0 ) {
-         for(j=0;j<4;j++)base64_ibuf[j]=0;
-         rcnt = rl_sread(base64_ibuf,3);
-         if( rcnt < 1 ) { return(ocnt); }
+         for(j=0;j<3;j++) { /* Take the group straight from the disk data */
+            if( base64_scnt < 1 ) {
+               base64_scnt = rl_sread_map(&base64_src, 0x7FFF);
+               if( base64_scnt < 1 ) { break; } /* EOF */
+            }
+            base64_ibuf[j] = *base64_src++;
+            base64_scnt--;
+         }
+         if( j == 0 ) { return(ocnt); }
+         for(;j<3;j++)base64_ibuf[j]=0; /* Pad a short last group */
          x = ((((unsigned long)base64_ibuf[0])<<16) & 0xFF0000) |
              ((((unsigned long)base64_ibuf[1])<<8) & 0xFF00) |
              (((unsigned long)base64_ibuf[2]) & 0xFF);
@@ -213,6 +315,150 @@ base64_enc(char *buf, int len)
    return(ocnt);
 }
 
+/* For rl_bench_pass() in pdpmain.c, each pass starts a fresh image */
+int
+base64_bench(char *buf, unsigned int len)
+{
+   return(base64_enc(buf, (int)len));
+}
+
+int
+base64_bench_long(char *buf, unsigned int len)
+{
+   return(base64_enc_long(buf, (int)len));
+}
+
+void
+base64_bench_init()
+{
+   base64_idx = -1;
+   base64_scnt = 0;
+}
+#endif /* RLBENCH */
+
+#ifdef BASE85
+#ifdef BINARYSAFE
+#error "BASE85 is for a line that will not take raw bytes, not with BINARYSAFE"
+#endif /* BINARYSAFE */
+/* Base85, 5 chars for every 4 bytes instead of 4 for 3. The alphabet leaves
+   out the Kermit control prefix '#', the 8th-bit and repeat prefixes '&'
+   and '~', and DEL, so encode() never has to prefix anything. 'z' is not a
+   digit either, it stands for a whole group of zero bytes. rlb85.pl on the
+   host decodes it. The input side and base64_idx are shared with
+   base64_enc(), so openfile() starts both over the same way. */
+static char base85_tbl[] =
+   "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxy"
+   "!$%()*+-./:;<=>?@[]^_{|}";
+static char base85_obuf[6];
+static int base85_olen;			/* Chars in base85_obuf */
+
+/* Encode the 4 bytes at sp (big-endian) as 5 digits, or 'z' if all zero
+   and z is set.
+   The 32-bit group is divided by 85 a byte at a time, the remainder times
+   256 plus a byte is below 85*256, so each step is one 16-bit signed divide
+   and no long arithmetic is needed. Returns the chars written. */
+static int
+base85_grp(char *dp, UCHAR *sp, int z)
+{  char q[4];
+   int i, j, x;
+   if( z && (sp[0] | sp[1] | sp[2] | sp[3]) == 0 ) {
+      *dp = 'z';
+      return(1);
+   }
+   for(j=0;j<4;j++)q[j]=sp[j];
+   for(i=4;i>0;i--) {			/* Low digit first */
+      x = 0;
+      for(j=0;j<4;j++) {
+         x = (x << 8) | (q[j] & 0xFF);
+         q[j] = x / 85;
+         x = x % 85;
+      }
+      dp[i] = base85_tbl[x];
+   }
+   dp[0] = base85_tbl[(int)q[3]];	/* What is left is below 85 */
+   return(5);
+}
+
+/* Fill buf with up to len chars, a group at a time. A group goes through
+   base85_obuf when it does not fit in what is left of the packet. A short
+   last group of n bytes is padded with zeros and sent as its first n+1
+   digits, never as 'z'. */
+int
+base85_enc(char *buf, int len)
+{  char *dp=buf, *end=buf+len;
+   int j, n;
+   while( dp < end ) {
+      if( base64_idx >= 0 ) {		/* Rest of a group from last time */
+         *dp++ = base85_obuf[base64_idx++];
+         if( base64_idx >= base85_olen ) { base64_idx = -1; }
+         continue;
+      }
+      if( base64_scnt >= 4 && end - dp >= 5 ) { /* Straight through */
+         dp += base85_grp(dp, (UCHAR *)base64_src, 1);
+         base64_src += 4;
+         base64_scnt -= 4;
+         continue;
+      }
+      for(j=0;j<4;j++) {
+         if( base64_scnt < 1 ) {
+            base64_scnt = rl_sread_map(&base64_src, 0x7FFF);
+            if( base64_scnt < 1 ) { break; } /* EOF */
+         }
+         base64_ibuf[j] = *base64_src++;
+         base64_scnt--;
+      }
+      if( j == 0 ) { break; }
+      for(n=j;n<4;n++)base64_ibuf[n]=0;
+      base85_olen = base85_grp(base85_obuf, (UCHAR *)base64_ibuf, j == 4);
+      if( j < 4 ) { base85_olen = j + 1; } /* Short last group */
+      base64_idx = 0;
+   }
+   return((int)(dp - buf));
+}
+#endif /* BASE85 */
+
+#ifdef RLRESTORE
+#ifndef BINARYSAFE
+/* Restore: decode the base64 from the line straight into the track buffers.
+   Six bits go in per character and a byte comes out whenever eight are
+   waiting, so no more than 14 bits are ever held. Anything that is not a
+   base64 character (CR, LF, ...) is skipped. */
+static unsigned int base64_bits;	/* Bits not yet written */
+static int base64_nbits=0;		/* How many */
+
+static int
+base64_dec(UCHAR *s, int n)
+{  char *dp;
+   int c, room=0, used=0;
+   while( n-- > 0 ) {
+      c = *s++;
+      if( c >= 'A' && c <= 'Z' ) c -= 'A';
+      else if( c >= 'a' && c <= 'z' ) c -= 'a' - 26;
+      else if( c >= '0' && c <= '9' ) c -= '0' - 52;
+      else if( c == '+' ) c = 62;
+      else if( c == '/' ) c = 63;
+      else {
+         if( c == '=' ) { base64_nbits = 0; } /* Padding, drop the rest */
+         continue;
+      }
+      base64_bits = (base64_bits<<6) | c;
+      base64_nbits += 6;
+      if( base64_nbits < 8 ) { continue; }
+      base64_nbits -= 8;
+      if( room == 0 ) {			/* Next piece of track buffer */
+         if( used ) { rl_swrite_commit(used); used = 0; }
+         if( (room = rl_swrite_map(&dp)) == 0 ) { break; } /* Pack full */
+      }
+      *dp++ = (char)(base64_bits >> base64_nbits);
+      room--;
+      used++;
+   }
+   if( used ) { rl_swrite_commit(used); }
+   return(0);
+}
+#endif /* BINARYSAFE */
+#endif /* RLRESTORE */
+
 /*
   In this example, the output file is unbuffered to ensure that every
   output byte is commited.  The input file, however, is buffered for speed.
@@ -383,8 +629,8 @@ cons_puts("R> rcv_o: ");cons_hex((char*)&rcv_out,2,0);
         x = (int)rcvbuf[rcv_out++]; // Read next char
         if( rcv_out >= RCVBSZ ) { rcv_out = 0; }
 //cons_puts("rchr: ");cons_hex((char*)&x,2,1);
-        c = (k->parity) ? x & 0x7f : x & 0xff; /* Strip parity */
 #endif // NODLINTR
+        c = (k->parity) ? x & 0x7f : x & 0xff; /* Strip parity */
 
 #ifdef DBG1
 cons_puts("rchr: ");cons_hex((char*)&x,2,1);
@@ -407,7 +653,7 @@ cons_hex((char*)outbuf,(unsigned int)n,1);
             if (n++ > len)	/* Check length */
               return(0);
             else
-              *p++ = x & 0xff;
+              *p++ = c;		/* 8th bit comes from the ebq prefix */
         }
     }
     return(-1);
@@ -460,20 +706,373 @@ cons_hex((char*)p,(unsigned int)n,1);
     X_OK on success.
     X_ERROR on failure, including rejection based on name, size, or date.    
 */
+#ifdef TXTFILES
+/* Small text files made up on the fly, sent a line at a time */
+#define TXT_NONE   0
+#define TXT_BADMAP 1			/* Bad sector map */
+#define TXT_INCIDX 2			/* Incremental backup track index */
+#define TXT_DUPMAP 3			/* Duplicate track references */
+#define TXT_AMAP   4			/* Blocks sent, allocation map */
+static int txt_mode = TXT_NONE;		/* Which one is being sent */
+static int txt_idx = 0;			/* Next entry to list */
+static char txt_line[48];
+static unsigned int dec_tbl[] = { 100, 10, 1 };
+
+static char *
+txt_str(char *dp, char *sp) {		/* Append a string */
+    while (*sp)
+      *dp++ = *sp++;
+    return(dp);
+}
+
+static char *
+txt_dec(char *dp, unsigned int n) {	/* Append n < 1000 in decimal */
+    int i;
+    char c;
+    for (i = 0; i < 3; i++) {		/* By subtraction, no division */
+	c = '0';
+	while (n >= dec_tbl[i]) {
+	    n -= dec_tbl[i];
+	    c++;
+	}
+	if (c != '0' || i == 2 || dp[-1] != ' ')
+	  *dp++ = c;
+    }
+    return(dp);
+}
+
+static int
+name_ext(UCHAR * s, char * ext) {	/* Does filename s end in .ext? */
+    UCHAR *dot = (UCHAR *)0;
+    for (; *s; s++)
+      if (*s == '.')
+	dot = s;
+    if (!dot)
+      return(0);
+    for (dot++; *ext; dot++, ext++)
+      if ((*dot | 040) != *ext)		/* Either case */
+	return(0);
+    return(*dot == '\0');
+}
+#endif /* TXTFILES */
+
+#ifdef RLBADMAP
+/* The degraded mode bad sector map is sent as a text file at the end */
+static char *badmap_how[] = { "", " known\n", " found\n" };
+
+static int
+is_badmap(UCHAR * s) {			/* Is this the bad sector map? */
+    UCHAR *cp = (UCHAR *)"rlbad";
+    while (*cp) {
+	if ((*s | 040) != *cp)		/* Either case */
+	  return(0);
+	s++; cp++;
+    }
+    return(1);
+}
+
+static int
+badmap_next(void) {			/* Next line of the map, or 0 */
+    char *dp = txt_line;
+    RLBAD *bp;
+    if (txt_idx >= rl_nbad) {
+	if (rl_nbad == 0 && txt_idx == 0) {
+	    txt_idx++;
+	    dp = txt_str(dp, "No bad sectors\n");
+	}
+	return(dp - txt_line);
+    }
+    bp = &rl_bad[txt_idx++];
+    dp = txt_str(dp, "rl");
+    *dp++ = '0' + bp->drv;
+    dp = txt_str(dp, " cyl ");
+    dp = txt_dec(dp, bp->cyl);
+    dp = txt_str(dp, " head ");
+    dp = txt_dec(dp, bp->hed);
+    dp = txt_str(dp, " sector ");
+    dp = txt_dec(dp, bp->sec);
+    dp = txt_str(dp, badmap_how[bp->how]);
+    return(dp - txt_line);
+}
+#endif /* RLBADMAP */
+
+#ifdef RLINCR
+/*
+  Incremental backup. The host first sends rlN.crc, the manifest from the
+  last backup with one line of 4 hex digits (CRC-16) per track, in track
+  order (cyl*2+head). Each line is queued as it comes in and checked from
+  rl_ahead() while the rest of the manifest arrives, whatever is left when
+  it ends is checked by main() after the receive, so the EOF is ACKed
+  without waiting on the disk. Then rlN.idx lists the tracks that
+  differ and rlN.inc holds just those.
+*/
+static int inc_rcv = 0;			/* 1=Receiving the manifest */
+static unsigned int inc_crc;		/* CRC being collected */
+static int inc_nd;			/* Hex digits in inc_crc so far */
+
+static void
+inc_line(void) {			/* One manifest line complete */
+    if (inc_nd)
+      rl_inc_track(inc_crc);		/* Checked later, see rl_inc_step() */
+    inc_crc = 0;
+    inc_nd = 0;
+}
+
+static int
+incidx_next(void) {			/* Next line of the track index, or 0 */
+    char *dp = txt_line;
+    int ntrk = rlst_ptr->type ? RL_TRACKS : (RL_TRACKS/2); /* RL02 or RL01 */
+    while (txt_idx < ntrk && !rl_inc_changed((unsigned int)txt_idx))
+      txt_idx++;
+    if (txt_idx >= ntrk)
+      return(0);
+    dp = txt_str(dp, "cyl ");
+    dp = txt_dec(dp, (unsigned int)txt_idx >> 1);
+    dp = txt_str(dp, " head ");
+    dp = txt_dec(dp, (unsigned int)txt_idx & 1);
+    *dp++ = '\n';
+    txt_idx++;
+    return(dp - txt_line);
+}
+#endif /* RLINCR */
+
+#ifdef RLDEDUP
+/*
+  Cross-drive dedup. A track already sent in this session is left out of
+  the rlN image and rldup.txt, sent last, says where it went:
+    rl1 cyl 12 head 0 = rl0 cyl 12 head 0
+  The host puts each image back together in the order it was sent, taking
+  the listed tracks from the image (and track) named, see rldup.pl.
+*/
+static int
+is_dupmap(UCHAR * s) {			/* Is this the duplicate list? */
+    UCHAR *cp = (UCHAR *)"rldup";
+    while (*cp) {
+	if ((*s | 040) != *cp)		/* Either case */
+	  return(0);
+	s++; cp++;
+    }
+    return(1);
+}
+
+static char *
+dup_trk(char *dp, unsigned int t) {	/* Append "rlN cyl C head H" */
+    dp = txt_str(dp, "rl");
+    *dp++ = '0' + (t >> 10);
+    dp = txt_str(dp, " cyl ");
+    dp = txt_dec(dp, (t >> 1) & 0777);
+    dp = txt_str(dp, " head ");
+    dp = txt_dec(dp, t & 1);
+    return(dp);
+}
+
+static int
+dupmap_next(void) {			/* Next line of the list, or 0 */
+    char *dp = txt_line;
+    if (txt_idx >= rl_ndup) {
+	if (rl_ndup == 0 && txt_idx == 0) {
+	    txt_idx++;
+	    dp = txt_str(dp, "No duplicate tracks\n");
+	}
+	return(dp - txt_line);
+    }
+    dp = dup_trk(dp, rl_dup[txt_idx].trk);
+    dp = txt_str(dp, " = ");
+    dp = dup_trk(dp, rl_dup[txt_idx].ref);
+    *dp++ = '\n';
+    txt_idx++;
+    return(dp - txt_line);
+}
+#endif /* RLDEDUP */
+
+#ifdef RLAMAP
+/*
+  Allocation aware backup. rlN.map is sent first, a bit per 512 byte
+  block of the pack, set for the blocks in rlN.blk that follows. Blocks
+  the file system has free (V7 free list, RT-11 empty areas, clear RSTS/E
+  SATT bits) are cleared, the host zeroes those, see rlmap.pl.
+  The first line names the file system, then bit n is (1 << (n & 7)) of
+  byte n/8, 16 bytes in hex per line.
+*/
+static char hex_dig[] = "0123456789abcdef";
+static char *amap_fmts[] = { "none", "v7", "rt11", "rsts" };
+
+static int
+amap_next(void) {			/* Next line of the map, or 0 */
+    char *dp = txt_line;
+    int i, b;
+    unsigned int off;
+    if (txt_idx == 0) {
+	txt_idx++;
+	dp = txt_str(dp, "format ");
+	dp = txt_str(dp, amap_fmts[rl_amap_fmt]);
+	*dp++ = '\n';
+	return(dp - txt_line);
+    }
+    off = (unsigned int)(txt_idx - 1) << 4;
+    if (off >= (rl_amap_nblk >> 3))
+      return(0);
+    for (i = 0; i < 16; i++) {
+	b = rl_amap[off + i];
+	*dp++ = hex_dig[(b >> 4) & 0xF];
+	*dp++ = hex_dig[b & 0xF];
+    }
+    *dp++ = '\n';
+    txt_idx++;
+    return(dp - txt_line);
+}
+#endif /* RLAMAP */
+
+#ifdef RLV7GET
+/*
+  V7 file extraction. The host sends a .get file first, one "rlN:/path"
+  per line, and each of those is then sent back as just that file off
+  the V7 file system on drive N.
+*/
+#define GET_NBUF 256			/* Bytes of names kept */
+static char get_buf[GET_NBUF];
+static int get_len = 0;
+static int get_rcv = 0;			/* 1=Receiving the list */
+
+static char *
+v7_path(UCHAR * s, int * drv) {		/* Path after "rlN:" and N, or 0 */
+    for (; *s; s++)
+      if ((s[0] | 040) == 'r' && (s[1] | 040) == 'l' &&
+	  s[2] >= '0' && s[2] <= '3' && s[3] == ':') {
+	  *drv = s[2] - '0';
+	  return((char *)s + 4);
+      }
+    return((char *)0);
+}
+
 int
-openfile(struct k_data * k, UCHAR * s, int mode) {
+get_names(UCHAR ** list, int max) {	/* Names from the list, 0 ends */
+    int i, n = 0;
+    char *cp = get_buf;
+    for (i = 0; i < get_len && n < max; i++) {
+	if (get_buf[i] == '\r' || get_buf[i] == '\n') {
+	    get_buf[i] = '\0';		/* One name per line */
+	    if (*cp)
+	      list[n++] = (UCHAR *)cp;
+	    cp = &get_buf[i+1];
+	}
+    }
+    if (n < max && cp < &get_buf[get_len]) {
+	get_buf[get_len] = '\0';		/* Last line may have no newline */
+	list[n++] = (UCHAR *)cp;
+    }
+    list[n] = (UCHAR *)0;
+    return(n);
+}
+#endif /* RLV7GET */
+
+static int
+name2drv(UCHAR * s) {			/* Drive number in a filename, or -1 */
     UCHAR *cp = s;
-    int i;
-    unsigned int drv = 0;
+    int drv = -1;
     while( *cp ) { // Scan filename for drive number
        if( (cp[0]=='r' || cp[0]=='R') && (cp[1]=='l' || cp[1]=='L') &&
            cp[2]>='0' && cp[2]<='3' ) {
-          drv = (unsigned int) (cp[2] - '0') & 0x3;
+          drv = (int) (cp[2] - '0') & 0x3;
        }
        cp++;
     }
+    return(drv);
+}
+
+static int
+file_drv(UCHAR * s) {			/* Drive a file is read from, or -1 */
+#ifdef RLV7GET
+    int drv;
+    if (v7_path(s, &drv))		/* The prefix, "rl0:/a/rl1.c" is 0 */
+      return(drv);
+#endif /* RLV7GET */
+    return(name2drv(s));		/* Image name */
+}
+
+int
+openfile(struct k_data * k, UCHAR * s, int mode) {
+    int i;
+    unsigned int drv = 0;
+#ifdef RLV7GET
+    char *path;
+#endif /* RLV7GET */
+#ifdef TXTFILES
+    txt_mode = TXT_NONE;
+#ifdef RLBADMAP
+    if (mode == 1 && is_badmap(s))	/* Bad sector map, not a disk */
+      txt_mode = TXT_BADMAP;
+#endif /* RLBADMAP */
+#ifdef RLINCR
+    if (mode == 1 && name_ext(s, "idx"))	/* Changed track list */
+      txt_mode = TXT_INCIDX;
+    rl_inc_on = (mode == 1 && name_ext(s, "inc"));
+#endif /* RLINCR */
+#ifdef RLDEDUP
+    if (mode == 1 && is_dupmap(s))	/* Duplicate track references */
+      txt_mode = TXT_DUPMAP;
+    rl_dup_on = (mode == 1 && txt_mode == TXT_NONE);
+#endif /* RLDEDUP */
+#ifdef RLAMAP
+    rl_amap_on = 0;
+    if (mode == 1 && name_ext(s, "map")) { /* Allocation map, read it */
+	if ((i = name2drv(s)) >= 0)
+	  drv = (unsigned int)i;
+	rl_amap_init(drv);
+	txt_mode = TXT_AMAP;
+    }
+#endif /* RLAMAP */
+    if (txt_mode != TXT_NONE) {
+	txt_idx = 0;
+	k->s_first   = 1;
+	k->zinbuf[0] = '\0';
+	k->zinptr    = k->zinbuf;
+	k->zincnt    = 0;
+	return(X_OK);
+    }
+#endif /* TXTFILES */
+    if ((i = file_drv(s)) >= 0)
+      drv = (unsigned int)i;
+#ifdef RLINCR
+    if (mode == 2 && name_ext(s, "crc")) { /* Manifest, nothing written */
+	rl_inc_init(drv);
+	rlst_ptr = rl_status(drv, 0);	/* RL01 or RL02 for the index */
+	inc_rcv = 1;
+	inc_crc = 0;
+	inc_nd  = 0;
+	return(X_OK);
+    }
+#endif /* RLINCR */
+#ifdef RLV7GET
+    if (mode == 2 && name_ext(s, "get")) { /* File list, nothing written */
+	get_rcv = 1;
+	get_len = 0;
+	return(X_OK);
+    }
+    if (mode == 1 && (path = v7_path(s, &i))) { /* One file off the pack */
+	rl_drive_selected = drv;
+	rl_sread_init();
+	if (rl_v7f_open(drv, path) < 0)
+	  return(X_ERROR);		/* Not V7, or no such plain file */
+	base64_idx = -1;
+	base64_scnt = 0;
+	k->s_first   = 1;
+	k->zinbuf[0] = '\0';
+	k->zinptr    = k->zinbuf;
+	k->zincnt    = 0;
+	return(X_OK);
+    }
+#endif /* RLV7GET */
+#ifdef RLAMAP
+    rl_amap_on = (mode == 1 && name_ext(s, "blk") && rl_amap_nblk &&
+		drv == rl_amap_drv);	/* Only after its map */
+#endif /* RLAMAP */
     rl_drive_selected = drv;
     rl_sread_init();
+    base64_idx = -1;			/* Nothing left from a previous file */
+    base64_scnt = 0;
+    if (mode == 1 && k->filelist && *(k->filelist)) /* More drives to send */
+      rl_sread_next(file_drv(*(k->filelist)));
 #ifdef DBG1
 cons_puts("openfile(");
 cons_puts((char*)s);
@@ -494,6 +1093,9 @@ cons_num("Mode: ",(unsigned int)mode);
 	if( (rlst_ptr->cs_cmd_rtn & (unsigned int)RL_CS_ERR) != (unsigned int)0 ) {
 	    return(X_ERROR);
 	}
+#ifdef RLBADMAP
+	rl_bad_load(drv);		/* Known bad sectors, never retried */
+#endif /* RLBADMAP */
 	k->s_first   = 1;		/* Set up for getkpt */
 	k->zinbuf[0] = '\0';		/* Initialize buffer */
 	k->zinptr    = k->zinbuf;	/* Set up buffer pointer */
@@ -504,6 +1106,19 @@ cons_puts("openfile() rtn=OK\n\r");
 	return(X_OK);
 
       case 2:				/* Write (create) */
+#ifdef RLRESTORE
+	/* Restore the image onto the pack */
+#ifdef RLWCHK
+	if (rl_swrite_init(drv, 1) < 0)	/* Write Check every track buffer */
+#else /* RLWCHK */
+	if (rl_swrite_init(drv, 0) < 0)
+#endif /* RLWCHK */
+	  return(X_ERROR);		/* Not ready or write locked */
+#ifndef BINARYSAFE
+	base64_nbits = 0;
+#endif /* BINARYSAFE */
+	return(X_OK);
+#endif /* RLRESTORE */
         rl_wait_dready(drv, 1, 1);
         rlst_ptr = rl_seek(drv, (unsigned int)0);
         rlst_ptr->chridx = (unsigned long)0;
@@ -553,6 +1168,27 @@ fileinfo(struct k_data * k,
     buf[0] = '\0';
     if (buflen < 18)
       return(X_ERROR);
+#ifdef TXTFILES
+    if (txt_mode != TXT_NONE		/* Length not known in advance */
+#ifdef RLINCR
+	|| rl_inc_on
+#endif /* RLINCR */
+#ifdef RLDEDUP
+	|| rl_dup_on			/* Tracks may be left out */
+#endif /* RLDEDUP */
+#ifdef RLAMAP
+	|| rl_amap_on			/* Free blocks left out */
+#endif /* RLAMAP */
+#ifdef RLV7GET
+	|| rl_v7f_on			/* One file, not the pack */
+#endif /* RLV7GET */
+	) {
+	while( *icp && buflen>0 ) { *ocp = *icp; ocp++; icp++; buflen--; }
+	*ocp++ = 0;
+	*type = 1;
+	return((ULONG)-1L);
+    }
+#endif /* TXTFILES */
     rlst_ptr = rl_status(rl_drive_selected, 0 );
     if( (rlst_ptr->cs_cmd_rtn & (unsigned int)RL_CS_ERR) != (unsigned int)0 ) {
       return(X_ERROR);
@@ -574,6 +1210,9 @@ fileinfo(struct k_data * k,
 #endif /* BINARYSAFE */
 
     }
+#ifdef BASE85
+    sz = (ULONG)-1L; // Unknown until sent, each 'z' is one char for four
+#endif /* BASE85 */
 
 #ifdef DBG1
 cons_puts("fileinfo: ");
@@ -586,37 +1225,24 @@ cons_hex((char*)&sz,4,0);
 }
 
 // This numstring() routine is defined here because of the
-// pdp11 division with long problem. We avoid this issue by knowing
-// the string values of the RL01 & RL02 but require access
-// to the type information
-#ifdef BINARYSAFE
-static char rl01len[] = "5242880"; // Normal binary RL01 size
-static char rl02len[] = "10485760"; // Normal binary RL02 size
-#else /* BINARYSAFE */
-static char rl01len[] = "6990508";
-static char rl02len[] = "13981016";
-#endif /* BINARYSAFE */
+// pdp11 division with long problem. divu10() in kermit.c takes the
+// digits off with shifts and adds, so any size fileinfo() gives is sent.
+extern unsigned long divu10(unsigned long);
+extern long l_rmdr;
 
 STATIC UCHAR *                          /* Convert number to string */
 numstring(ULONG n, UCHAR * buf, int buflen, struct k_data * k) {
-    int i, x;
-    char *sp;
-    buf[buflen - 1] = '\0';
-    if( rlst_ptr->mp_status & RL_MP_STA_DT ) { // Drive Type 0=RL01 1=RL02
-       //sp = rl02len;
-       sp = rl02len; // DBG1 test last two tracks
-    } else {
-       sp = rl01len;
-    }
-    i=0;
-    while( sp[i] && i<(buflen-1) ) { // Copy number string
-       buf[i] = sp[i];
-       i++;
+    int i;
+    i = buflen - 1;
+    buf[i] = '\0';
+    do {
+       n = divu10(n);
+       buf[--i] = (UCHAR)l_rmdr + '0';
+    } while( n && i > 0 );
+    if( n ) {
+       return((UCHAR *)0);		/* Does not fit */
     }
-    buf[i]=0;
-
-//cons_puts("\n\rNumstr: ");cons_hex((char*)buf,(i+1),1);
-    return((UCHAR *)buf);
+    return(&buf[i]);
 }
 
 
@@ -636,7 +1262,35 @@ readfile(struct k_data * k) {
 #ifdef DBG1
 cons_puts("\r\nReadFile start\n");
 #endif
+#ifdef TXTFILES
+    if (txt_mode != TXT_NONE) {		/* One line at a time */
+	if (k->zincnt < 1) {
+#ifdef RLBADMAP
+	    if (txt_mode == TXT_BADMAP)
+	      k->zincnt = badmap_next();
+#endif /* RLBADMAP */
+#ifdef RLINCR
+	    if (txt_mode == TXT_INCIDX)
+	      k->zincnt = incidx_next();
+#endif /* RLINCR */
+#ifdef RLDEDUP
+	    if (txt_mode == TXT_DUPMAP)
+	      k->zincnt = dupmap_next();
+#endif /* RLDEDUP */
+#ifdef RLAMAP
+	    if (txt_mode == TXT_AMAP)
+	      k->zincnt = amap_next();
+#endif /* RLAMAP */
+	    if (k->zincnt == 0)
+	      return(-1);
+	    k->zinptr = (UCHAR *)txt_line;
+	}
+	(k->zincnt)--;
+	return(*(k->zinptr)++ & 0xff);
+    }
+#endif /* TXTFILES */
     if (k->zincnt < 1) {		/* Nothing in buffer - must refill */
+	UCHAR *zp = k->zinbuf;		/* Where the new data starts */
 	k->dummy = 0;
 #ifdef DBG1
 cons_puts("ReadFile rl_fread()\n");
@@ -663,15 +1317,21 @@ cons_puts("ReadFile rl_fread()\n");
 #else // OLDFREAD
 	    
 #ifdef BINARYSAFE
-        k->zincnt = rl_sread(k->zinbuf, k->zinlen);
+        /* Zero-copy, hand Kermit the track buffer the RL11 read into */
+        k->zincnt = rl_sread_map((char **)&zp, k->zinlen);
 #else /* BINARYSAFE */
+#ifdef BASE85
+        k->zincnt = base85_enc(k->zinbuf, k->zinlen);
+#else /* BASE85 */
         k->zincnt = base64_enc(k->zinbuf, k->zinlen);
+#endif /* BASE85 */
 #endif /* BINARYSAFE */
 
 #endif // OLDFREAD
 #endif // DBG1
 
-	k->zinbuf[k->zincnt] = '\0';	/* Terminate. (Is this safe in binary?)*/
+	if (zp == k->zinbuf)		/* Never write into a track buffer */
+	  k->zinbuf[k->zincnt] = '\0';	/* Terminate. (Is this safe in binary?)*/
 	if (k->zincnt == 0) {		/* Check for EOF */
 #ifdef DBG1
 cons_puts("ReadFile rl_fread(EOF)\n");
@@ -687,7 +1347,7 @@ cons_puts(rlst_ptr->err_msg);
 #endif
 	  return(-1);
 	}
-	k->zinptr = k->zinbuf;		/* Not EOF - reset pointer */
+	k->zinptr = zp;			/* Not EOF - reset pointer */
     }
 
 #ifdef DBG1
@@ -715,6 +1375,44 @@ writefile(struct k_data * k, UCHAR * s, int n) {
     int rc;
     rc = X_OK;
 
+#ifdef RLINCR
+    if (inc_rcv) {			/* Manifest, check each track */
+	int i, d;
+	for (i = 0; i < n; i++) {
+	    d = s[i];
+	    if (d >= '0' && d <= '9')
+	      d -= '0';
+	    else if ((d | 040) >= 'a' && (d | 040) <= 'f')
+	      d = (d | 040) - 'a' + 10;
+	    else {			/* End of a line, or space */
+		inc_line();
+		continue;
+	    }
+	    inc_crc = (inc_crc << 4) | d;
+	    inc_nd++;
+	}
+	return(rc);
+    }
+#endif /* RLINCR */
+#ifdef RLV7GET
+    if (get_rcv) {			/* File list, keep what fits */
+	while (n-- > 0 && get_len < GET_NBUF - 1)
+	  get_buf[get_len++] = *s++;
+	return(rc);
+    }
+#endif /* RLV7GET */
+#ifdef RLRESTORE
+    if (rl_wr) {			/* Onto the pack */
+#ifdef BINARYSAFE
+	rl_swrite((char *)s, (unsigned int)n);
+#else /* BINARYSAFE */
+	base64_dec(s, n);
+#endif /* BINARYSAFE */
+	if (rl_wr_err)			/* Give up, the pack is bad */
+	  rc = X_ERROR;
+	return(rc);
+    }
+#endif /* RLRESTORE */
 #ifdef MORE_TODO
     debug(DB_LOG,"writefile binary",0,k->binary);
 
@@ -753,6 +1451,28 @@ int
 closefile(struct k_data * k, UCHAR c, int mode) {
     int rc = X_OK;			/* Return code */
 
+    if (mode == 1)			/* Stop reading ahead on the disk */
+      rl_sread_stop();
+#ifdef RLINCR
+    if (mode != 1 && inc_rcv) {		/* Manifest done */
+	inc_line();			/* Last line may have no newline */
+	inc_rcv = 0;
+    }
+#endif /* RLINCR */
+#ifdef RLV7GET
+    if (mode != 1)
+      get_rcv = 0;
+#endif /* RLV7GET */
+#ifdef RLRESTORE
+    if (mode != 1 && rl_wr) {		/* Last track buffer out, then wait */
+	if (rl_swrite_stop() < 0)
+	  rc = X_ERROR;
+    }
+#endif /* RLRESTORE */
+#ifdef RLSTATS
+    if (mode == 1)			/* Disk pass done, show the cost */
+      rl_cmd_stats();
+#endif /* RLSTATS */
     return(rc);
 #ifdef MORE_TODO
     switch (mode) {
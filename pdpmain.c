@@ -60,9 +60,76 @@ sizeof(long*)=2
 
 #define MBSZ 12
 char mbuf[MBSZ+4];
+#ifdef RLV7GET
+#undef RLBATCH /* Only the files the host asks for */
+/* V7 file extraction, the host sends a .get list, then gets these */
+UCHAR *sndfiles[GET_MAX+1];
+int get_names(UCHAR **, int);
+#else /* RLV7GET */
+#ifdef RLINCR
+#undef RLBATCH /* One drive at a time, the one named by the manifest */
+/* Incremental backup, the host sends rlN.crc first, then gets these */
+UCHAR inc_idx[] = "rl0.idx";
+UCHAR inc_dat[] = "rl0.inc";
 UCHAR *sndfiles[] = {
-   "rldisk01.b64"
+   inc_idx, /* Changed tracks */
+   inc_dat, /* and their data */
+#ifdef RLBADMAP
+   "rlbad.txt", /* Bad sector map goes last */
+#endif /* RLBADMAP */
+   (UCHAR *)0
 };
+#else /* RLINCR */
+#ifdef RLBATCH
+/* Batch mode sends every spun-up drive in one session */
+#ifdef RLAMAP
+UCHAR *rl_names[] = {
+   "rl0.blk", "rl1.blk", "rl2.blk", "rl3.blk"
+};
+UCHAR *rl_amaps[] = { /* Each allocation map goes just before its blocks */
+   "rl0.map", "rl1.map", "rl2.map", "rl3.map"
+};
+#else /* RLAMAP */
+UCHAR *rl_names[] = {
+#ifdef BINARYSAFE
+   "rl0.img", "rl1.img", "rl2.img", "rl3.img"
+#else /* BINARYSAFE */
+#ifdef BASE85
+   "rl0.b85", "rl1.b85", "rl2.b85", "rl3.b85"
+#else /* BASE85 */
+   "rl0.b64", "rl1.b64", "rl2.b64", "rl3.b64"
+#endif /* BASE85 */
+#endif /* BINARYSAFE */
+};
+#endif /* RLAMAP */
+UCHAR *sndfiles[11];
+#else /* RLBATCH */
+UCHAR *sndfiles[] = {
+#ifdef RLAMAP
+   "rl0.map", /* Blocks in use */
+   "rl0.blk", /* and their data */
+#else /* RLAMAP */
+#ifdef BINARYSAFE
+   "rldisk01.img", /* The raw image, as it is on the pack */
+#else /* BINARYSAFE */
+#ifdef BASE85
+   "rldisk01.b85", /* Decode with rlb85.pl */
+#else /* BASE85 */
+   "rldisk01.b64",
+#endif /* BASE85 */
+#endif /* BINARYSAFE */
+#endif /* RLAMAP */
+#ifdef RLDEDUP
+   "rldup.txt", /* Tracks left out as duplicates */
+#endif /* RLDEDUP */
+#ifdef RLBADMAP
+   "rlbad.txt", /* Bad sector map goes last */
+#endif /* RLBADMAP */
+   (UCHAR *)0
+};
+#endif /* RLBATCH */
+#endif /* RLINCR */
+#endif /* RLV7GET */
 
 int devopen(char *);                    /* Communications device/path */
 int devsettings(char *);
@@ -87,6 +154,7 @@ ULONG fileinfo(struct k_data *, UCHAR *, UCHAR *, int, short *, short);
 /* This is the clock tick counter */
 volatile unsigned int cktick;
 volatile unsigned long cksec_cnt=0;
+volatile unsigned long cktot=0; // All ticks, for timing shorter than a sec
 volatile unsigned int spnow;
 volatile unsigned int spmin=0x7FFF;
 
@@ -103,6 +171,7 @@ void
 ckint()  // Called only from the clock interrupt routine
 {
    cktick++;
+   cktot++;
    if( spnow < spmin ) { spmin = spnow; }
    if( cktick >= 60 ) {
       cktick=0;
@@ -328,6 +397,106 @@ cons_hex(char *ptr,unsigned int len,int ascfg)
 }
 
 
+#ifdef RLBENCH
+/* Time the sequential readers on the console before Kermit starts.
+   Build with RLFLAGS="-DRLBENCH -DDUMMYBLK" to leave the disk out and time
+   only the copy. Under SIMH with "set throttle <n>M" each tick is n*1000000/60
+   instructions, so instructions per byte = ticks * n * 1000000 / 60 / bytes.
+   For the base64 passes divide by the input bytes, and take off the
+   rl_sread() figure to leave what the encoder itself costs per disk byte.
+*/
+#ifndef RLBENCH_SECS
+#define RLBENCH_SECS 4096 // Sectors per timed pass (1MB)
+#endif
+/* Chars out of the encoder for the pass, folded by the compiler as there
+   is no long divide at run time */
+#define RLBENCH_B64 ((((long)RLBENCH_SECS << 8) + 2L) / 3L * 4L)
+char rlbench_buf[512];
+int base64_bench(char *, unsigned int);
+int base64_bench_long(char *, unsigned int);
+void base64_bench_init();
+
+/* With b64 set rd is an encoder, it is run until it has taken the same
+   RLBENCH_SECS of disk data, and the input bytes are printed as well. */
+void
+rl_bench_pass(char *name, int (*rd)(char *, unsigned int), int b64)
+{  unsigned long t0, bytes=0L;
+   unsigned long want = (unsigned long)RLBENCH_SECS << 8;
+   int n;
+   if( b64 ) {
+      want = RLBENCH_B64;
+      base64_bench_init();
+   }
+   rl_sread_init();
+   rl_wait_dready(0, 1, 1);
+#ifdef RLSTATS
+   rl_stats_clear(); /* This pass only */
+#endif /* RLSTATS */
+   t0 = cktot;
+   while( bytes < want ) {
+      n = (*rd)(rlbench_buf, sizeof(rlbench_buf));
+      if( n < 1 ) { break; }
+      bytes += (unsigned long)n;
+   }
+   t0 = cktot - t0;
+   rl_sread_stop();
+   cons_puts("\n");
+   cons_puts(name);
+   cons_lnum("Bytes:",bytes);
+   if( b64 ) { /* 3 in for 4 out */
+      cons_lnum("Input bytes:",((bytes >> 2) << 1) + (bytes >> 2));
+   }
+   cons_lnum("Ticks:",t0);
+#ifdef RLSTATS
+   rl_cmd_stats();
+#endif /* RLSTATS */
+}
+#endif /* RLBENCH */
+
+#ifdef RLCOPY
+/* Console copy command before Kermit starts, "copy rl0 rl1" copies the
+   pack in drive 0 onto drive 1 and write-checks it. An empty line goes
+   on to Kermit.
+*/
+void
+rl_copy_cmd(RLDSK *rlp)
+{  char line[40];
+   char *cp;
+   int drv[2], n;
+   unsigned long t0;
+   while( 1 ) {
+      cons_puts("\r\nRLCOPY> ");
+      line[0] = 0;
+      cons_gets(line, sizeof(line));
+      if( line[0] == 0 ) {
+         return;
+      }
+      for(cp=line,n=0;*cp && n<2;cp++) { /* Source, then destination */
+         if( (cp[0]=='r' || cp[0]=='R') && (cp[1]=='l' || cp[1]=='L') &&
+             cp[2]>='0' && cp[2]<='3' ) {
+            drv[n++] = cp[2] - '0';
+         }
+      }
+      if( n < 2 || drv[0] == drv[1] ) {
+         cons_puts("copy rlN rlM, or an empty line for Kermit\r\n");
+         continue;
+      }
+      t0 = cktot;
+      if( rl_copy((unsigned int)drv[0], (unsigned int)drv[1]) ) {
+         cons_puts("\r\nFAILED rl");
+         cons_putc((char)('0' + rlp->drive_num));
+         cons_puts(": ");
+         cons_puts(rlp->err_msg);
+         cons_num("Cylinder:",rlp->last_cylinder);
+         cons_num("Head:",rlp->last_head);
+      } else {
+         cons_puts("\r\nDone");
+      }
+      cons_lnum("Ticks:",cktot - t0);
+   }
+}
+#endif /* RLCOPY */
+
 int main()
 {
    int status, rx_len, i, x;
@@ -339,14 +508,37 @@ int main()
    volatile unsigned int *ptr;
    RLDSK *rlp;
 
+#ifdef RLMMU
+   rl_mmu_init();                      /* Track cache in upper memory */
+#endif /* RLMMU */
    if (!devopen("dummy"))              /* Open the communication device */
       doexit(FAILURE);
     if (!devsettings("dummy"))          /* Perform any needed settings */
       doexit(FAILURE);
 
+#ifdef RLBATCH
+    /* Check every drive, the ones spun up all start seeking to cylinder 0 */
+    for(i=0,x=0;i<4;i++) {
+       if( rl_ready_start((unsigned int)i) ) {
+#ifdef RLAMAP
+          sndfiles[x++] = rl_amaps[i];
+#endif /* RLAMAP */
+          sndfiles[x++] = rl_names[i];
+       }
+    }
+#ifdef RLDEDUP
+    sndfiles[x++] = "rldup.txt"; /* Tracks left out as duplicates */
+#endif /* RLDEDUP */
+#ifdef RLBADMAP
+    sndfiles[x++] = "rlbad.txt"; /* Bad sector map goes last */
+#endif /* RLBADMAP */
+    sndfiles[x] = (UCHAR *)0;
+    rlp = rl_status((unsigned int)0,0);
+#else /* RLBATCH */
     rl_wait_dready(0, 1, 1);
     rlp = rl_seek(0, (unsigned int)0);
     rlp = rl_status((unsigned int)0,0);
+#endif /* RLBATCH */
 
 #ifdef WAIT
 while( mbuf[0] != 1 ) {
@@ -402,7 +594,23 @@ cons_puts("Starting kermit loop after delay of 15sec\r");
 start_sec = cksec_cnt;
 while( cksec_cnt < ( start_sec+(unsigned long)15L ) );
 #endif /* DBG1 */
+#ifdef RLCOPY
+    rl_copy_cmd(rlp);
+#endif /* RLCOPY */
+#ifdef RLBENCH
+    rl_bench_pass("rl_sread_bytewise()",rl_sread_bytewise,0);
+    rl_bench_pass("rl_sread()",rl_sread,0);
+    rl_bench_pass("base64_enc_long()",base64_bench_long,1);
+    rl_bench_pass("base64_enc()",base64_bench,1);
+#ifdef RLBENCH_HALT
+    asm("halt"); /* Hand back to the SIMH script, see rlbench.sh */
+#endif /* RLBENCH_HALT */
+#endif /* RLBENCH */
+#if defined(RLINCR) || defined(RLRESTORE) || defined(RLV7GET)
+    action = A_RECV; // Get the manifest, image or file list first
+#else
     action = A_SEND; // This is the default, sending the image
+#endif /* RLINCR || RLRESTORE || RLV7GET */
 
 
 while( 1 ) {
@@ -446,6 +654,9 @@ while( 1 ) {
     if (status == X_ERROR)
       doexit(FAILURE);
     if (action == A_SEND) {
+#ifdef RLDEDUP
+      rl_dup_init();                    /* Nothing sent yet this session */
+#endif /* RLDEDUP */
       status = kermit(K_SEND, &k, 0, 0, "", &r);
     }
 
@@ -498,6 +709,7 @@ cons_puts("kermit(RUN) Starting\n");
         switch (status = kermit(K_RUN, &k, r_slot, rx_len, "", &r)) {
 	  case X_OK:
 	    /* Maybe do other brief tasks here... */
+	    rl_ahead();			/* Keep the disk reading ahead */
 	    continue;			/* Keep looping */
 	  case X_DONE:
 	    break;			/* Finished */
@@ -505,6 +717,21 @@ cons_puts("kermit(RUN) Starting\n");
 	    doexit(FAILURE);		/* Failed */
 	}
     }
+#ifdef RLINCR
+    if (action == A_RECV) {		/* Manifest in, send the changes */
+	rl_inc_flush();			/* Tracks still queued */
+	inc_idx[2] = inc_dat[2] = '0' + rl_inc_drv;
+	action = A_SEND;
+	continue;
+    }
+#endif /* RLINCR */
+#ifdef RLV7GET
+    if (action == A_RECV) {		/* List in, send the files on it */
+	get_names(sndfiles, GET_MAX);
+	action = A_SEND;
+	continue;
+    }
+#endif /* RLV7GET */
     doexit(SUCCESS);
 }
 
@@ -43,11 +43,14 @@
 #define HAVE_USHORT 1
 
 
+/* Without long packets no packet holds more than 94 chars, so the file
+   buffers need not be big. The 12K they had is where the RL track
+   buffers (RL_BUF_BUDGET in rl.h) find room in a 32K machine. */
 #ifndef IBUFLEN
-#define IBUFLEN  4096			/* File input buffer size */
+#define IBUFLEN  512			/* File input buffer size */
 #endif /* IBUFLEN */
 
 #ifndef OBUFLEN
-#define OBUFLEN  8192                   /* File output buffer size */
+#define OBUFLEN  512                    /* File output buffer size */
 #endif /* OBUFLEN */
 
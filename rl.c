@@ -40,10 +40,45 @@
 #include "console.h"
 
 extern void cons_num(char *msg,unsigned int x);
+extern void cons_lnum(char *msg,unsigned long x);
 #define BUF (rlst.last_blk)
 
 volatile RLDSK rlst;
 
+#ifdef RLSTATS
+// Where the disk time goes, see rl_cmd_stats()
+extern volatile unsigned long cktot;
+RLSTAT rlstat;
+static unsigned long rl_seek_t0; // When the last seek was issued
+static int rl_seek_on=0; // 1=Seek issued, its end not seen yet
+static unsigned long rl_xfer_t0; // When the transfer in flight started
+static unsigned long rl_full_t0=0; // When the read-ahead found no free buffer
+static unsigned long rl_wait_t0; // When the reader started on a buffer
+
+// Count v in the power of two histogram h: 0, 1, 2-3, 4-7, ... and up
+static void
+rl_hist(unsigned int *h, unsigned long v)
+{  int b = 0;
+   while( v && b < (RL_HIST-1) ) {
+      v >>= 1;
+      b++;
+   }
+   h[b]++;
+}
+
+// Count the error in cs, if any, by its code
+static void
+rl_stat_err(unsigned int cs)
+{
+   if( cs & RL_CS_CERR ) {
+      rlstat.errs[(cs & RL_CS_ERR)>>10]++;
+   }
+   if( cs & RL_CS_DERR ) {
+      rlstat.drv_errs++;
+   }
+}
+#endif // RLSTATS
+
 
 long
 twos_comp(int bits, long n)
@@ -58,255 +93,1971 @@ twos_comp(int bits, long n)
       } else {
          x=0;
       }
-      x = x<<i;
-      c = c | x;
+      x = x<<i;
+      c = c | x;
+   }
+   c++;
+   return(c);
+}
+
+
+// Map a logical sector (LBA) to cylinder/head/sector without division,
+// there is no divide helper in the -nostdlib build. An RL cylinder holds
+// 80 sectors, so cyl = (lba>>4)/5, and the divide by 5 is done with the
+// shift and add sequence for multiplying by 0.2 (exact below 2^16).
+static void
+rl_lba_chs(unsigned int lba, unsigned int *c, unsigned int *h, unsigned int *s)
+{  unsigned int x, q, r;
+   x = lba>>4;
+   q = (x>>3) + (x>>4); // About x*0.2 from below
+   q = q + (q>>4);
+   q = q + (q>>8);
+   r = x - ((q<<2) + q);
+   while( r >= 5 ) { r -= 5; q++; } // At most a few steps
+   *c = q;
+   r = lba - ((q<<6) + (q<<4)); // q*80, 0-79 sectors into the cylinder
+   if( r >= RL_SECTORS ) {
+      *h = 1;
+      r -= RL_SECTORS;
+   } else {
+      *h = 0;
+   }
+   *s = r;
+}
+
+// This subroutine depends on rlst.type which is set by rl_status()
+RLDSK*
+logical_sec2shc(unsigned int logical_sec)
+{  unsigned int s, h, c;
+   if( rlst.type ) {
+      if( logical_sec >= RL2_LBAS ) { logical_sec = RL2_LBAS-1; } // Max
+   } else {
+      if( logical_sec >= RL1_LBAS ) { logical_sec = RL1_LBAS-1; } // Max
+   }
+   rl_lba_chs(logical_sec, &c, &h, &s);
+   rlst.sector = s;
+   rlst.head = h;
+   rlst.cylinder = c;
+   return(&rlst);
+}
+
+// Read count sectors starting at logical sector lba into buf, any place
+// on the pack. The range is cut at track ends and each piece is read
+// with a single Read Data. Not for use while the sequential reader has
+// a read in flight, call rl_sread_stop() first.
+// Return 0=OK, -1=out of range or read error (see rlst.last_error)
+int
+rl_read_lba(unsigned int drv, unsigned int lba, unsigned int count, char *buf)
+{
+   return(rl_read_lbapa(drv, lba, count, RL_PA(buf)));
+}
+
+// Same into physical memory at pa
+int
+rl_read_lbapa(unsigned int drv, unsigned int lba, unsigned int count, unsigned long pa)
+{  unsigned int c, h, s, n, max;
+   if( !rlst.pos_valid || rlst.pos_drive != drv ) {
+      rl_status(drv, 1); // Also finds RL01 or RL02
+   }
+   max = rlst.type ? RL2_LBAS : RL1_LBAS;
+   if( lba >= max || count > max - lba ) {
+      rlst.last_error = RL_ERR_OPI;
+      rlst.err_msg = "LBA out of range";
+      return(-1);
+   }
+   while( count > 0 ) {
+      rl_lba_chs(lba, &c, &h, &s);
+      n = RL_SECTORS - s; // Rest of this track
+      if( n > count ) { n = count; }
+      rl_read_pa(drv, s, h, c, n*RL_SECTOR_WSIZE, pa);
+      if( rlst.cs_cmd_rtn & RL_CS_CERR ) {
+         return(-1);
+      }
+      pa += n*RL_SECTOR_BSIZE;
+      lba += n;
+      count -= n;
+   }
+   return(0);
+}
+
+// Seek drv to cyl with the head selected in rlst.head.
+// While the head position is known (pos_valid) the Read Header commands
+// are skipped, and nothing is issued if the heads are already there.
+RLDSK*
+rl_seek(unsigned int drv, unsigned int cyl)
+{
+   volatile unsigned int *ptr = (unsigned int*)RL_DA;
+   int target, current, offset;
+   unsigned int dir, hed;
+   target = (int)cyl;
+   hed = rlst.head & 1; // Head wanted by the caller
+   if( rlst.pos_valid && rlst.pos_drive == drv ) {
+      current = rlst.pos_cylinder;
+      if( current == target && rlst.pos_head == hed ) {
+         rlst.cylinder = cyl;
+         return(&rlst); // Already there
+      }
+   } else {
+      rl_read_hdr();
+      current = rlst.cylinder;
+      if( current == target && rlst.head == hed ) {
+         rlst.pos_drive = drv;
+         rlst.pos_cylinder = cyl;
+         rlst.pos_head = hed;
+         rlst.pos_valid = 1;
+         return(&rlst);
+      }
+   }
+   offset = target - current; // Signed result for direction +=toward spindle
+   if( offset >= 0 ) {
+      dir = 1; // toward spindle
+   } else {
+      dir = 0; // away from spindle
+      offset = -offset; // Difference is a magnitude
+   }
+   *ptr = (((unsigned int)offset<<7) & RL_DA_SK_DF) | 
+          ((hed<<4) & RL_DA_SK_HS) | 
+          (((unsigned int)dir<<2) & RL_DA_SK_DIR) |
+          ((unsigned int)0x01);
+   rl_wait_dready(drv, 0, 0);
+   rl_cmd((unsigned int)drv,(unsigned int)RL_CMD_SEEK);
+#ifdef RLSTATS
+   rl_stat_err(rlst.cs_cmd_rtn); // Transfers are counted in rl_read_done()
+   rl_hist(rlstat.seek_dist, (unsigned long)offset);
+   rl_seek_t0 = cktot;
+   rl_seek_on = 1;
+#endif // RLSTATS
+   rlst.head = hed;
+   rlst.cylinder = cyl;
+   rlst.pos_drive = drv;
+   rlst.pos_cylinder = cyl;
+   rlst.pos_head = hed;
+   rlst.pos_valid = ((rlst.cs_cmd_rtn & RL_CS_CERR) == 0);
+   return(&rlst);
+}
+
+RLDSK*
+rl_read(unsigned int drv, unsigned int sec, unsigned int hed, unsigned int cyl, unsigned int words_cnt)
+{
+//cons_puts("rl_read: start\n");
+   if( words_cnt > RL_SECTOR_WSIZE ) {
+      cons_puts("ERROR:Larger then one block needs rl_read_buf()\n\r");
+      return(&rlst); // The limit is our buffer size
+   }
+   return(rl_read_buf(drv, sec, hed, cyl, words_cnt, (char*)BUF));
+}
+
+// Read words_cnt words starting at sec into buf with one Read Data command.
+// The RL11 moves on to the following sectors by itself, so up to a full
+// track (40 sectors, 10KB) can be read, but never past the end of the track.
+RLDSK*
+rl_read_buf(unsigned int drv, unsigned int sec, unsigned int hed, unsigned int cyl, unsigned int words_cnt, char *buf)
+{
+   rl_read_start(drv, sec, hed, cyl, words_cnt, buf);
+   while( ! rl_read_done() ); // Wait for the interrupt
+   return(&rlst);
+}
+
+// Same into memory at physical address pa, anywhere the controller reaches
+RLDSK*
+rl_read_pa(unsigned int drv, unsigned int sec, unsigned int hed, unsigned int cyl, unsigned int words_cnt, unsigned long pa)
+{
+   rl_xfer_startpa(RL_CMD_RDAT, drv, sec, hed, cyl, words_cnt, pa);
+   while( ! rl_read_done() ); // Wait for the interrupt
+   return(&rlst);
+}
+
+#ifndef NORLINTR
+volatile unsigned int rl_busy=0; // 1=Command started, interrupt not seen yet
+volatile unsigned int rl_intr_cs=0; // CS saved by the interrupt
+
+void
+rlint()  // Called only from the RL interrupt routine
+{
+   volatile unsigned int *rp=(volatile unsigned int *)RL_CS;
+   rl_intr_cs = *rp;
+   rl_busy = 0;
+}
+#else // NORLINTR
+void
+rlint()
+{
+}
+#endif // NORLINTR
+
+// Start a Read Data of words_cnt words into buf and return without waiting
+// for the transfer, rl_read_done() tells when it has finished. The seek,
+// when one is needed, is still waited for before the read is started.
+// No other rl_* call may be made until rl_read_done() has returned 1.
+RLDSK*
+rl_read_start(unsigned int drv, unsigned int sec, unsigned int hed, unsigned int cyl, unsigned int words_cnt, char *buf)
+{
+   return(rl_xfer_start(RL_CMD_RDAT, drv, sec, hed, cyl, words_cnt, buf));
+}
+
+// Same for any data transfer function fn (RDAT, WDAT, WCHK), the end of
+// the transfer is also found with rl_read_done().
+RLDSK*
+rl_xfer_start(unsigned int fn, unsigned int drv, unsigned int sec, unsigned int hed, unsigned int cyl, unsigned int words_cnt, char *buf)
+{
+   return(rl_xfer_startpa(fn, drv, sec, hed, cyl, words_cnt, RL_PA(buf)));
+}
+
+// And with the physical address pa, which can be above 64KB
+RLDSK*
+rl_xfer_startpa(unsigned int fn, unsigned int drv, unsigned int sec, unsigned int hed, unsigned int cyl, unsigned int words_cnt, unsigned long pa)
+{
+   volatile unsigned int *ptr = (unsigned int*)RL_BA;
+   unsigned int r, i;
+   long x;
+
+   if( words_cnt > (unsigned int)((RL_SECTORS - sec) * RL_SECTOR_WSIZE) ) {
+      cons_puts("ERROR:Transfer past end of track not supported\n\r");
+      rlst.cs_cmd_rtn = RL_CS_CERR | RL_ERR_OPI;
+#ifndef NORLINTR
+      rl_intr_cs = rlst.cs_cmd_rtn; // rl_read_done() reports the error
+#endif // NORLINTR
+      return(&rlst);
+   }
+   if( !rlst.pos_valid || rlst.pos_drive != drv ) {
+      rl_status(drv, 1); // Unknown state, reset the drive first
+   }
+   rlst.head = hed;
+//cons_puts("rl_read: seek:");cons_hex((char*)&cyl,2,0);
+   rl_seek(drv,cyl); // Verify cyl location
+   x = twos_comp(13,(long)words_cnt);
+   rlst.rw_word_cnt = (unsigned int)words_cnt;
+   rlst.rw_word_2s = x;
+   //cons_num("MP-X2: ",(unsigned int)x);
+
+//cons_puts("rl_read: cyl: ");cons_hex((char*)&cyl,2,0);
+//cons_puts("rl_read: hed: ");cons_hex((char*)&hed,2,0);
+//cons_puts("rl_read: sec: ");cons_hex((char*)&sec,2,0);
+   rl_wait_dready(drv,0,0); // Wait for the seek
+   ptr = (unsigned int*)RL_DA;
+   i = ((cyl<<7) & RL_MP_HDR_CYL) | ((hed<<6) & RL_MP_HDR_HEAD) | (sec & RL_MP_HDR_SEC);
+   *ptr = (unsigned int)i;  // Where to read!
+   //cons_num("Read DA: ",i);
+   rlst.da_reg = *ptr;
+
+   ptr = (unsigned int*)RL_MP;
+   *ptr = (unsigned int)0160000 | ((unsigned int)(x & 017777));
+   rlst.mp_status = *ptr;
+   rlst.last_sector = sec;
+   rlst.last_head = hed;
+   rlst.last_cylinder = cyl;
+#ifdef RLSTATS
+   rl_xfer_t0 = cktot;
+#endif // RLSTATS
+   rl_cmd_startpa((unsigned int)drv,fn,pa);
+   return(&rlst);
+}
+
+// Return 0 while the transfer started by rl_read_start() is running,
+// 1 once it is done and the result is in rlst.
+int
+rl_read_done()
+{
+#ifndef NORLINTR
+   if( rl_busy ) {
+      return(0);
+   }
+   rlst.cs_cmd_rtn = rl_intr_cs;
+#endif // NORLINTR
+   rlst.last_error = rlst.cs_cmd_rtn & RL_CS_ERR;
+   rlst.err_msg = rl_decode_err(rlst.cs_cmd_rtn);
+   if( rlst.cs_cmd_rtn & RL_CS_CERR ) {
+      rlst.pos_valid = 0; // Verify the position again on the retry
+   }
+#ifdef RLSTATS
+   rl_hist(rlstat.xfer_ticks, cktot - rl_xfer_t0);
+   rl_stat_err(rlst.cs_cmd_rtn);
+#endif // RLSTATS
+//cons_puts("rl_read: return\n");
+   return(1);
+}
+
+// Seek drv to the track if needed and return the sector whose header
+// comes under the head next, or -1 when the heads are not where expected.
+int
+rl_next_sector(unsigned int drv, unsigned int hed, unsigned int cyl)
+{  int s;
+   if( !rlst.pos_valid || rlst.pos_drive != drv ) {
+      rl_status(drv, 1); // Unknown state, reset the drive first
+   }
+   rlst.head = hed;
+   rl_seek(drv,cyl);
+   rl_wait_dready(drv,0,0); // Wait for the seek
+   rl_read_hdr(); // Sector just passed under the head
+   if( (rlst.cs_cmd_rtn & RL_CS_CERR) || rlst.cylinder != cyl ||
+       rlst.head != hed ) {
+      rlst.pos_valid = 0;
+      return(-1);
+   }
+   s = rlst.sector + 1;
+   if( s >= RL_SECTORS ) { s = 0; }
+   return(s);
+}
+
+#ifndef NEWCODE
+// Read next buffer from current disk, and record position
+// 4th version, a ring of RL_NBUF track buffers is kept filled ahead of
+// the reader. One Read Data runs (interrupt driven) while the reader
+// drains the buffer before it, so the disk keeps pace with the line.
+#define RL_TB_EMPTY 0 // Free for the next read
+#define RL_TB_READING 1 // Read Data in flight
+#define RL_TB_FULL 2 // Data ready for the reader
+#define RL_TB_ERROR 3 // Read failed after retries, reader stops here
+
+typedef struct RLtbuf {
+   int sec; // First sector held
+   int hed;
+   int cyl;
+   int nsec; // Sectors held
+   int split; // RL_RPS: sectors from sec still to read after the wrap
+   volatile int state;
+#ifdef RLMMU
+   unsigned long pa; // Physical address of the data, above the program
+#else // RLMMU
+   char data[RL_TRKBUF_BSIZE];
+#endif // RLMMU
+} RLTBUF;
+
+RLTBUF rl_tbuf[RL_NBUF];
+
+#ifdef RLMMU
+// KT11 mode: the track buffers are physical memory the program cannot
+// address. The controller gets their physical address, the CPU looks at
+// them through an 8KB window page mapped to the spot wanted. The reader
+// has its own window so rl_ahead() can use the other meanwhile.
+#define KT_MMR0 0177572 // Memory management status, bit 0 enables
+#define KT_KIPDR0 0172300 // Kernel I space page descriptors 0-7
+#define KT_KIPAR0 0172340 // Kernel I space page address registers 0-7
+#define RL_WIN_RD 6 // Page for the reader (0140000)
+#define RL_WIN_IO 5 // Page for rl.c itself (0120000)
+
+// Map window page pg onto physical address pa and return where pa now
+// is, *room is how many bytes the window shows from there
+static char *
+rl_win(unsigned int pg, unsigned long pa, unsigned int *room)
+{
+   volatile unsigned int *par = (unsigned int *)KT_KIPAR0;
+   par[pg] = (unsigned int)(pa >> 6); // In 64 byte blocks
+   if( room ) {
+      *room = 8192 - ((unsigned int)pa & 077);
+   }
+   return((char *)(pg << 13) + ((unsigned int)pa & 077));
+}
+// Turn on the MMU with pages 0-4 mapped straight through to the program,
+// page 7 on the I/O page, and give each track buffer its place in the
+// physical memory from RL_CACHE_PA up. Call before any other rl_* call.
+void
+rl_mmu_init()
+{  unsigned int i;
+   unsigned long pa = RL_CACHE_PA;
+   volatile unsigned int *par = (unsigned int *)KT_KIPAR0;
+   volatile unsigned int *pdr = (unsigned int *)KT_KIPDR0;
+   for(i=0;i<8;i++) {
+      par[i] = i << 7; // 8KB page is 0200 blocks of 64 bytes
+      pdr[i] = 077406; // Full 8KB page, read/write
+   }
+   par[7] = 07600; // 18 bit 0760000 is the I/O page
+   for(i=0;i<RL_NBUF;i++) {
+      rl_tbuf[i].pa = pa;
+      pa += RL_TRKBUF_BSIZE;
+   }
+   *((volatile unsigned int *)KT_MMR0) = 1; // Mapping on
+}
+
+#define TB_PA(tb,off) ((tb)->pa + (unsigned int)(off))
+#define TB_RD(tb,off,room) rl_win(RL_WIN_RD, TB_PA(tb,off), room)
+#define TB_IO(tb,off) rl_win(RL_WIN_IO, TB_PA(tb,off), (unsigned int *)0)
+#else // RLMMU
+#define TB_PA(tb,off) RL_PA(&(tb)->data[off])
+#define TB_RD(tb,off,room) (*(room) = 0xFFFF, &(tb)->data[off])
+#define TB_IO(tb,off) (&(tb)->data[off])
+#endif // RLMMU
+
+volatile int rl_tcur=0; // Buffer the reader is draining
+volatile int rl_tnxt=0; // Buffer the next read goes into
+volatile int rl_off=0; // Offset into rl_tbuf[rl_tcur].data
+volatile int rl_hed=0; // Next track position to read ahead
+volatile int rl_sec=0;
+volatile int rl_cyl=0;
+volatile int rl_feof=1; // 1=Nothing more to read ahead
+volatile int rl_nxt_drv=(-1); // Drive to get ready once this one is read
+
+// Wait for a read still in flight and stop reading ahead
+void
+rl_sread_stop()
+{  int i;
+   for(i=0;i<RL_NBUF;i++) {
+      if( rl_tbuf[i].state == RL_TB_READING ) {
+         while( ! rl_read_done() );
+      }
+      rl_tbuf[i].state = RL_TB_EMPTY;
+   }
+   rl_feof=1;
+}
+
+void
+rl_sread_init()
+{
+   rl_sread_stop();
+#ifdef RLV7GET
+   rl_v7f_on=0; // The pack, not a file on it
+#endif // RLV7GET
+   rl_hed=0;
+   rl_sec=0;
+   rl_cyl=0;
+   rl_off=0;
+   rl_tcur=0;
+   rl_tnxt=0;
+   rl_feof=0;
+   rl_nxt_drv=(-1);
+}
+
+// Name the drive to get ready in the background after the current one
+void
+rl_sread_next(int drv)
+{
+   rl_nxt_drv = drv;
+}
+
+// Check drv is spun up and locked on, and start its heads back to
+// cylinder 0 without waiting for the seek to finish.
+// Return 1=drive ready for reading, 0=not there or not spun up
+int
+rl_ready_start(unsigned int drv)
+{
+   rl_status(drv, 1);
+   if( (rlst.cs_cmd_rtn & RL_CS_CERR) ||
+       (rlst.mp_status & RL_MP_STA_DSE) ||
+       (rlst.mp_status & RL_MP_STA_DRV) != 5 ) { // 5=Lock on
+      return(0);
+   }
+   rlst.head = 0;
+   rl_seek(drv, (unsigned int)0);
+   return(1);
+}
+
+// Return 1 once the selected drive can take a command, 0 while its heads
+// are still moving. An error also counts as ready, the command that
+// follows resets the drive.
+static int
+rl_drv_idle()
+{
+   volatile unsigned int *rp=(unsigned int *)RL_CS;
+   return( (*rp & (RL_CS_DRDY | RL_CS_CERR | RL_CS_DERR)) != 0 );
+}
+
+// Start the Read Data that fills track buffer tb
+static void
+rl_ahead_start(RLTBUF *tb)
+{
+#ifdef RL_RPS
+   int i = -1;
+#endif // RL_RPS
+   tb->state = RL_TB_READING;
+#ifdef RL_RPS
+   // Start with the first wanted sector still to come under the head and
+   // pick up the ones before it after the wrap, instead of waiting for
+   // sector tb->sec to come round again.
+   tb->split = 0;
+   if( tb->nsec > 1 ) {
+      i = rl_next_sector(rlst.drive_num, tb->hed, tb->cyl);
+      if( i > tb->sec && i < (tb->sec + tb->nsec) ) {
+         tb->split = i - tb->sec;
+      }
+   }
+   if( tb->split ) {
+      rl_xfer_startpa(RL_CMD_RDAT, rlst.drive_num, i, tb->hed, tb->cyl,
+                    (unsigned int)((tb->nsec - tb->split) * RL_SECTOR_WSIZE),
+                    TB_PA(tb, tb->split * RL_SECTOR_BSIZE));
+      return;
+   }
+#endif // RL_RPS
+   rl_xfer_startpa(RL_CMD_RDAT, rlst.drive_num, tb->sec, tb->hed, tb->cyl,
+                   (unsigned int)(tb->nsec * RL_SECTOR_WSIZE), TB_PA(tb, 0));
+}
+
+#ifdef RLBADMAP
+// Degraded mode: instead of ending the file at a sector that will not read,
+// record it in rl_bad[], fill it with RL_BAD_FILL and carry on.
+RLBAD rl_bad[RL_BADMAX];
+int rl_nbad=0;
+static char rl_bad_fill[] = RL_BAD_FILL;
+extern volatile unsigned long cktot;
+
+// Return index of a sector in rl_bad[], or -1
+int
+rl_bad_find(unsigned int drv, unsigned int cyl, unsigned int hed, unsigned int sec)
+{  int i;
+   for(i=0;i<rl_nbad;i++) {
+      if( rl_bad[i].cyl == cyl && rl_bad[i].sec == sec &&
+          rl_bad[i].hed == hed && rl_bad[i].drv == drv ) {
+         return(i);
+      }
+   }
+   return(-1);
+}
+
+void
+rl_bad_add(unsigned int drv, unsigned int cyl, unsigned int hed, unsigned int sec, unsigned int how)
+{
+   if( rl_nbad >= RL_BADMAX || rl_bad_find(drv,cyl,hed,sec) >= 0 ) {
+      return; // Full, or already there
+   }
+   rl_bad[rl_nbad].drv = drv;
+   rl_bad[rl_nbad].cyl = cyl;
+   rl_bad[rl_nbad].hed = hed;
+   rl_bad[rl_nbad].sec = sec;
+   rl_bad[rl_nbad].how = how;
+   rl_nbad++;
+}
+
+// Return 1 if any of n sectors from sec is a known bad sector
+int
+rl_bad_in(unsigned int drv, unsigned int cyl, unsigned int hed, unsigned int sec, unsigned int n)
+{  int i;
+   for(i=0;i<rl_nbad;i++) {
+      if( rl_bad[i].how == RL_BAD_KNOWN && rl_bad[i].cyl == cyl &&
+          rl_bad[i].hed == hed && rl_bad[i].drv == drv &&
+          rl_bad[i].sec >= sec && rl_bad[i].sec < (sec + n) ) {
+         return(1);
+      }
+   }
+   return(0);
+}
+
+// Read the DEC STD 144 bad sector file from the last track of drv into
+// rl_bad[]. Sectors 0-9 hold copies of the manufacturer's list and
+// sectors 20-29 copies of the list added in the field, the first copy
+// that reads is used. Each entry is a cylinder word and a track<<8|sector
+// word after a 4 word header, and a pair of 0177777 ends the list.
+void
+rl_bad_load(unsigned int drv)
+{  int copy, base, i;
+   unsigned int cyl, ts;
+   unsigned int *wp = (unsigned int *)BUF;
+   unsigned int maxcyl = RL2_CYL;
+   if( rlst.type == 0 ) { // RL01?
+      maxcyl = RL1_CYL;
+   }
+   for(base=0;base<=20;base+=20) {
+      for(copy=0;copy<10;copy++) {
+         rl_read(drv, (unsigned int)(base + copy), 1, maxcyl - 1,
+                 (unsigned int)RL_SECTOR_WSIZE);
+         if( rlst.last_error == 0 ) {
+            break;
+         }
+      }
+      if( rlst.last_error ) {
+         continue; // No readable copy
+      }
+      for(i=4;i<(RL_SECTOR_WSIZE-1);i+=2) {
+         cyl = wp[i];
+         ts = wp[i+1];
+         if( cyl == 0177777 && ts == 0177777 ) {
+            break; // End of list
+         }
+         if( cyl < maxcyl && ((ts>>8) & 0377) <= 1 &&
+             (ts & 0377) < RL_SECTORS ) {
+            rl_bad_add(drv, cyl, (ts>>8) & 1, ts & 0377, RL_BAD_KNOWN);
+         }
+      }
+   }
+}
+
+// Fill tb one sector at a time. Known bad sectors are not read at all,
+// others get RL_BAD_TRIES reads within RL_BAD_TICKS clock ticks before
+// they are marked bad. The buffer always ends up full.
+static void
+rl_salvage(RLTBUF *tb)
+{  int i, j, tries;
+   unsigned long t0;
+   char *dp;
+   for(i=0;i<tb->nsec;i++) {
+      if( rl_bad_find(rlst.drive_num, tb->cyl, tb->hed, tb->sec + i) < 0 ) {
+         t0 = cktot;
+         for(tries=0;tries<RL_BAD_TRIES;tries++) {
+            if( tries ) {
+               rl_wait_dready(rlst.drive_num, 1, 1); // Reset & retry
+#ifdef RLSTATS
+               rlstat.retries++;
+#endif // RLSTATS
+            }
+            rl_read_pa(rlst.drive_num, tb->sec + i, tb->hed, tb->cyl,
+                       (unsigned int)RL_SECTOR_WSIZE,
+                       TB_PA(tb, i * RL_SECTOR_BSIZE));
+            if( rlst.last_error == 0 || (cktot - t0) >= RL_BAD_TICKS ) {
+               break;
+            }
+         }
+         if( rlst.last_error == 0 ) {
+            continue; // Good after all
+         }
+         rl_bad_add(rlst.drive_num, tb->cyl, tb->hed, tb->sec + i, RL_BAD_FOUND);
+      }
+      dp = TB_IO(tb, i * RL_SECTOR_BSIZE);
+      for(j=0;j<RL_SECTOR_BSIZE;j++) {
+         dp[j] = rl_bad_fill[j & (sizeof(rl_bad_fill) - 2)];
+      }
+   }
+   rlst.last_error = 0;
+   tb->state = RL_TB_FULL;
+}
+#endif // RLBADMAP
+
+#if defined(RLINCR) || defined(RLDEDUP)
+static unsigned int rl_crc_tbl[256];
+
+// CRC-16/CCITT of n bytes at p, carried on from crc (start RL_CRC_INIT)
+unsigned int
+rl_crc(unsigned int crc, char *p, unsigned int n)
+{
+   while( n-- ) {
+      crc = (crc<<8) ^ rl_crc_tbl[((crc>>8) ^ *p++) & 0xFF];
+   }
+   return(crc & 0xFFFF);
+}
+
+// Fill in rl_crc_tbl[], a byte at a time table with 8 shifts per entry
+static void
+rl_crc_init()
+{  unsigned int i, j, c;
+   for(i=0;i<256;i++) {
+      c = i<<8;
+      for(j=0;j<8;j++) {
+         c = (c & 0x8000) ? ((c<<1) ^ 0x1021) : (c<<1);
+      }
+      rl_crc_tbl[i] = c & 0xFFFF;
+   }
+}
+#endif // RLINCR || RLDEDUP
+
+#ifdef RLINCR
+// Incremental backup: rl_inc_same[] has a bit set for each track of
+// rl_inc_drv whose CRC matched the host manifest, those are left out of
+// the sequential read while rl_inc_on is set.
+// The manifest CRCs are queued in rl_inc_q[] as they come in and checked
+// from rl_ahead() a track buffer at a time, so writefile() returns (and the
+// packet is ACKed) without waiting for the disk.
+unsigned int rl_inc_drv=0;
+int rl_inc_on=0;
+static unsigned char rl_inc_same[RL_TRACKS/8];
+static unsigned int rl_inc_q[RL_INC_QLEN]; // CRCs still to check
+static int rl_inc_qout; // Oldest, it is for track rl_inc_trk
+static int rl_inc_qn; // How many
+static unsigned int rl_inc_trk; // Track being checked
+static unsigned int rl_inc_ntrk; // Tracks on the pack
+static unsigned int rl_inc_sec; // Its next piece starts here
+static unsigned int rl_inc_crc; // CRC of the pieces so far
+static int rl_inc_busy; // Read Data of a piece in flight
+
+// Get ready to check the manifest for drv, every track counts as changed
+void
+rl_inc_init(unsigned int drv)
+{  unsigned int i;
+   rl_sread_stop();
+   rl_crc_init();
+   for(i=0;i<sizeof(rl_inc_same);i++) { rl_inc_same[i] = 0; }
+   rl_inc_drv = drv;
+   rl_wait_dready(drv, 1, 1);
+   rl_inc_ntrk = rlst.type ? RL_TRACKS : (RL_TRACKS/2); // RL02 or RL01
+   rl_inc_qout = 0;
+   rl_inc_qn = 0;
+   rl_inc_trk = 0;
+   rl_inc_sec = 0;
+   rl_inc_crc = RL_CRC_INIT;
+   rl_inc_busy = 0;
+}
+
+// Take one step on the oldest queued track: start the Read Data of its
+// next piece into the first track buffer, or once that is done fold the
+// piece into the CRC, and after the last piece compare it with the
+// manifest. Never waits for the disk. Return the CRCs still queued.
+int
+rl_inc_step()
+{  unsigned int n, i;
+   RLTBUF *tb = &rl_tbuf[0];
+   if( rl_inc_qn == 0 ) {
+      return(0);
+   }
+   n = RL_SECTORS - rl_inc_sec;
+   if( n > RL_TRKSECS ) { n = RL_TRKSECS; }
+   if( rl_inc_trk >= rl_inc_ntrk ) { // Not on this pack, leave it changed
+      rl_inc_sec = RL_SECTORS;
+   } else if( !rl_inc_busy ) {
+      rl_xfer_startpa(RL_CMD_RDAT, rl_inc_drv, rl_inc_sec, rl_inc_trk & 1,
+                      rl_inc_trk >> 1, (unsigned int)(n * RL_SECTOR_WSIZE),
+                      TB_PA(tb, 0));
+      rl_inc_busy = 1;
+      return(rl_inc_qn);
+   } else if( ! rl_read_done() ) {
+      return(rl_inc_qn); // Still transferring
+   } else {
+      rl_inc_busy = 0;
+      if( rlst.last_error ) { // Send it, the host gets to see what is there
+         rl_wait_dready(rl_inc_drv, 1, 1);
+         rl_inc_crc = ~rl_inc_q[rl_inc_qout];
+         rl_inc_sec = RL_SECTORS;
+      } else {
+         for(i=0;i<n;i++) { // A sector at a time, it always fits the window
+            rl_inc_crc = rl_crc(rl_inc_crc, TB_IO(tb, i*RL_SECTOR_BSIZE),
+                                RL_SECTOR_BSIZE);
+         }
+         rl_inc_sec += n;
+      }
+   }
+   if( rl_inc_sec >= RL_SECTORS ) { // Track done, on to the next one
+      if( rl_inc_trk < rl_inc_ntrk &&
+          rl_inc_crc == (rl_inc_q[rl_inc_qout] & 0xFFFF) ) {
+         rl_inc_same[rl_inc_trk>>3] |= (unsigned char)(1<<(rl_inc_trk & 7));
+      }
+      if( ++rl_inc_qout >= RL_INC_QLEN ) { rl_inc_qout = 0; }
+      rl_inc_qn--;
+      rl_inc_trk++;
+      rl_inc_sec = 0;
+      rl_inc_crc = RL_CRC_INIT;
+   }
+   return(rl_inc_qn);
+}
+
+// Queue the manifest CRC of the next track. Only when the queue is full
+// does this wait, for the oldest track to be checked.
+void
+rl_inc_track(unsigned int crc)
+{  int i;
+   while( rl_inc_qn >= RL_INC_QLEN ) {
+      rl_inc_step();
+   }
+   i = rl_inc_qout + rl_inc_qn;
+   if( i >= RL_INC_QLEN ) { i -= RL_INC_QLEN; }
+   rl_inc_q[i] = crc;
+   rl_inc_qn++;
+}
+
+// Check whatever the manifest left queued, before the index goes out
+void
+rl_inc_flush()
+{
+   while( rl_inc_step() );
+}
+
+// Return 1 if track trk of rl_inc_drv has to be sent
+int
+rl_inc_changed(unsigned int trk)
+{
+   if( trk >= RL_TRACKS ) {
+      return(1);
+   }
+   return( (rl_inc_same[trk>>3] & (1<<(trk & 7))) == 0 );
+}
+#endif // RLINCR
+
+#ifdef RLDEDUP
+// Cross-drive dedup: every track sent in this session goes in a hash
+// table by CRC. A track read later with a CRC already there is compared
+// against that track on its own drive, and if it really is the same only
+// a reference to it goes into rl_dup[] and the reader never sees it.
+// Tracks are (drv<<10)|(cyl*2+head), 0 in rl_fp_trk[] is a free slot.
+int rl_dup_on=0;
+RLDUP rl_dup[RL_DUP_MAX];
+int rl_ndup=0;
+static unsigned int rl_fp_crc[RL_DUP_FPS];
+static unsigned int rl_fp_trk[RL_DUP_FPS];
+static unsigned int rl_fp_n=0;
+static int rl_dup_full=0; // Told the console a table is full
+static char rl_dup_buf[RL_DUP_SECS*RL_SECTOR_BSIZE];
+
+// Forget every track sent, for a new session
+void
+rl_dup_init()
+{  unsigned int i;
+   rl_crc_init();
+   for(i=0;i<RL_DUP_FPS;i++) { rl_fp_trk[i] = 0; }
+   rl_fp_n = 0;
+   rl_ndup = 0;
+   rl_dup_on = 0;
+   rl_dup_full = 0;
+}
+
+// Return 1 if track ref on its drive holds the same bytes as tb
+static int
+rl_dup_same(RLTBUF *tb, unsigned int ref)
+{  unsigned int drv = ref>>10, cyl = (ref>>1) & 0777, hed = ref & 1;
+   unsigned int s, i;
+   char *dp;
+   for(s=0;s<RL_SECTORS;s+=RL_DUP_SECS) {
+      rl_read_pa(drv, s, hed, cyl, RL_DUP_SECS*RL_SECTOR_WSIZE,
+                 RL_PA(rl_dup_buf));
+      if( rlst.last_error ) {
+         return(0); // Cannot tell, send it
+      }
+      for(i=0;i<RL_DUP_SECS*RL_SECTOR_BSIZE;i++) {
+         if( (i & (RL_SECTOR_BSIZE-1)) == 0 ) { // Window moves by sector
+            dp = TB_IO(tb, s*RL_SECTOR_BSIZE + i);
+         }
+         if( *dp++ != rl_dup_buf[i] ) {
+            return(0);
+         }
+      }
+   }
+   return(1);
+}
+
+// tb holds a whole track just read from the current drive. Return 1 if
+// it was sent before in this session (and is now listed in rl_dup[]),
+// 0 if it has to be sent.
+static int
+rl_dup_track(RLTBUF *tb)
+{  unsigned int drv = rlst.drive_num;
+   unsigned int trk = (drv<<10) | (tb->cyl<<1) | tb->hed;
+   unsigned int crc = RL_CRC_INIT;
+   unsigned int i, n, h, ref = 0;
+   for(i=0;i<RL_SECTORS;i++) { // A sector at a time, it always fits the window
+      crc = rl_crc(crc, TB_IO(tb, i*RL_SECTOR_BSIZE), RL_SECTOR_BSIZE);
+   }
+   h = crc & (RL_DUP_FPS-1);
+   for(n=0;n<RL_DUP_FPS && rl_fp_trk[h];n++) { // Linear probing
+      if( rl_fp_crc[h] == crc && rl_ndup < RL_DUP_MAX &&
+          rl_dup_same(tb, rl_fp_trk[h] - 1) ) {
+         ref = rl_fp_trk[h];
+         break;
+      }
+      h = (h + 1) & (RL_DUP_FPS-1);
+   }
+   if( rlst.drive_num != drv || !rlst.pos_valid ) {
+      rl_wait_dready(drv, 1, 1); // Back on the drive being sent
+   }
+   if( ref ) {
+      rl_dup[rl_ndup].trk = trk;
+      rl_dup[rl_ndup].ref = ref - 1;
+      if( ++rl_ndup >= RL_DUP_MAX && !rl_dup_full ) {
+         cons_puts("NOTE:Dedup reference table full\n\r");
+         rl_dup_full = 1;
+      }
+      return(1);
+   }
+   if( n < RL_DUP_FPS && rl_fp_n < RL_DUP_FPS-1 ) { // New, remember it
+      rl_fp_crc[h] = crc;
+      rl_fp_trk[h] = trk + 1;
+      rl_fp_n++;
+   } else if( !rl_dup_full ) { // Once, the rest go out whole
+      cons_puts("NOTE:Dedup track table full\n\r");
+      rl_dup_full = 1;
+   }
+   return(0);
+}
+#endif // RLDEDUP
+
+#ifdef RLAMAP
+// Allocation aware backup: rl_amap[] has a bit per 512 byte block of the
+// pack, set for the blocks to send. rl_amap_init() clears the ones the
+// file system on the pack has free, and while rl_amap_on the sequential
+// reader passes over them. Anything the parsers do not understand leaves
+// every bit set, so the whole pack goes.
+unsigned char rl_amap[RL2_LBAS/16];
+unsigned int rl_amap_nblk=0; // Blocks on the pack, bits used in rl_amap
+unsigned int rl_amap_drv=0;
+int rl_amap_on=0;
+int rl_amap_fmt=RL_AMAP_NONE;
+
+// Read nsec sectors of block bno (plus base) into the first track buffer,
+// return a pointer to its words or 0 if unreadable
+static unsigned int *
+rl_amap_rd(unsigned int bno, unsigned int nsec)
+{  RLTBUF *tb = &rl_tbuf[0];
+   if( bno >= rl_amap_nblk ||
+       rl_read_lbapa(rl_amap_drv, bno<<1, nsec, TB_PA(tb, 0)) ) {
+      return((unsigned int *)0);
+   }
+   return((unsigned int *)TB_IO(tb, 0));
+}
+
+// Mark n blocks from bno as free
+static void
+rl_amap_free(unsigned int bno, unsigned int n)
+{
+   while( n-- ) {
+      rl_amap[bno>>3] &= ~(1<<(bno & 7));
+      bno++;
+   }
+}
+
+#ifdef RLV7
+// Unix V7: the blocks on the superblock free list and the list blocks it
+// chains through are free. The chain blocks are kept, the rebuilt file
+// system needs them. Return 0=done, -1=not V7
+static int
+rl_amap_v7()
+{  unsigned int *wp;
+   unsigned int i, n, isize, fsize, bno, groups=0;
+   if( (wp = rl_amap_rd(RL_V7_BLK0 + 1, 1)) == 0 ) { // Superblock
+      return(-1);
+   }
+   // s_isize, s_fsize, s_nfree, s_free[]. A daddr_t is two words, the
+   // high one first, and is always below 64K blocks on an RL.
+   isize = wp[0];
+   fsize = wp[2];
+   if( wp[1] != 0 || isize < 2 || isize >= fsize ||
+       fsize > rl_amap_nblk - RL_V7_BLK0 ) {
+      return(-1);
+   }
+   n = wp[3];
+   wp += 4;
+   while( n > 0 ) {
+      if( n > RL_V7_NICFREE || ++groups > fsize ) {
+         return(-1); // Bad count, or going round in circles
+      }
+      for(i=n-1;i>0;i--) { // s_free[1..n-1] are free
+         bno = wp[(i<<1) + 1];
+         if( wp[i<<1] != 0 || bno < isize || bno >= fsize ) {
+            return(-1); // Not a block of this file system
+         }
+         rl_amap_free(RL_V7_BLK0 + bno, 1);
+      }
+      if( wp[0] != 0 ) {
+         return(-1);
+      }
+      bno = wp[1]; // s_free[0] holds the next n and 50 numbers
+      if( bno == 0 ) {
+         break; // End of the free list
+      }
+      if( bno < isize || bno >= fsize ||
+          (wp = rl_amap_rd(RL_V7_BLK0 + bno, 1)) == 0 ) {
+         return(-1);
+      }
+      n = wp[0]; // df_nfree, df_free[]
+      wp++;
+   }
+   return(0);
+}
+#endif // RLV7
+
+#ifdef RLRT11
+// RT-11: the home block names the first directory segment, each segment
+// lists files laid end to end from its start block. The space of the
+// empty entries is free, everything else is kept.
+// Return 0=done, -1=not RT-11
+static int
+rl_amap_rt11()
+{  static char sysid[] = "DECRT11A";
+   unsigned int *wp;
+   unsigned int first, seg, segs=0, ewords, i, bno, st, len;
+   char *cp;
+   if( (wp = rl_amap_rd(1, 2)) == 0 ) { // Home block
+      return(-1);
+   }
+   cp = (char *)wp + RL_RT11_SYSID;
+   for(i=0;sysid[i];i++) {
+      if( cp[i] != sysid[i] ) {
+         return(-1);
+      }
+   }
+   first = wp[RL_RT11_DSSEG>>1]; // Normally 6
+   seg = 1;
+   while( seg != 0 ) {
+      if( ++segs > RL_RT11_MAXSEG ) {
+         return(-1); // Going round in circles
+      }
+      if( (wp = rl_amap_rd(first + ((seg - 1)<<1), 4)) == 0 ) {
+         return(-1);
+      }
+      // Segments, next segment, highest in use, extra bytes, start block
+      if( wp[0] == 0 || wp[0] > RL_RT11_MAXSEG || wp[1] > wp[0] ||
+          (wp[3] & 1) || wp[3] > 64 ) {
+         return(-1);
+      }
+      seg = wp[1];
+      ewords = 7 + (wp[3]>>1); // Status, name (3), length, job, date
+      bno = wp[4];
+      if( bno > rl_amap_nblk ) {
+         return(-1); // Segment starts off the pack
+      }
+      for(i=5;;i+=ewords) {
+         if( i >= 512 ) {
+            return(-1); // No end of segment mark
+         }
+         st = wp[i] & (RL_RT11_TENT | RL_RT11_MPTY | RL_RT11_PERM |
+                       RL_RT11_EOS);
+         if( st == RL_RT11_EOS ) {
+            break;
+         }
+         if( i + ewords > 512 ) {
+            return(-1);
+         }
+         len = wp[i+4];
+         if( (st != RL_RT11_TENT && st != RL_RT11_MPTY &&
+              st != RL_RT11_PERM) || len > rl_amap_nblk - bno ) {
+            return(-1); // Not a directory entry, or off the pack
+         }
+         if( st == RL_RT11_MPTY ) {
+            rl_amap_free(bno, len);
+         }
+         bno += len;
+      }
+   }
+   return(0);
+}
+#endif // RLRT11
+
+#ifdef RLRSTS
+// RSTS/E (RDS 1.x): follow the pack label to the MFD, the group 0 GFD and
+// the [0,1] UFD, find SATT.SYS there and free the pack clusters whose
+// bit is clear. The device cluster is one block on an RL.
+// Return 0=done, -1=not RSTS/E or not understood
+
+// Follow a directory link word through the cluster map clu[] (size,
+// then up to 7 DCNs) and return a pointer to the blockette, 0 if bad
+static unsigned int *
+rl_amap_lnk(unsigned int lnk, unsigned int *clu)
+{  unsigned int ci = (lnk>>12) & 7, blk = (lnk>>9) & 7;
+   unsigned int *wp;
+   if( ci >= 7 || blk >= clu[0] || clu[ci+1] == 0 ||
+       (wp = rl_amap_rd(clu[ci+1] + blk, 2)) == 0 ) {
+      return((unsigned int *)0);
+   }
+   return(wp + ((lnk & RL_RSTS_LNKOFF)>>1));
+}
+
+static int
+rl_amap_rsts()
+{  unsigned int *wp;
+   unsigned int clu[8], ret[8];
+   unsigned int pcs, s, mfd, gfd, ufd, fcs=0, i, j, k, n, b, cl, ncl, lnk;
+   if( (wp = rl_amap_rd(1, 1)) == 0 ) { // Pack label at DCN 1
+      return(-1);
+   }
+   pcs = wp[4];
+   if( wp[1] != 0177777 || (wp[3] & 0177400) != 0400 || pcs == 0 ||
+       pcs > 64 || (pcs & (pcs - 1)) ) {
+      return(-1); // Not RDS 1.x, or not a power of 2 pack cluster
+   }
+   for(s=0;(1<<s)<pcs;s++);
+   mfd = wp[2];
+   if( (wp = rl_amap_rd(mfd + 1, 1)) == 0 ) { // GFD pointers
+      return(-1);
+   }
+   gfd = wp[0]; // Group 0
+   if( gfd == 0 || (wp = rl_amap_rd(gfd + 1, 1)) == 0 ) { // UFD pointers
+      return(-1);
+   }
+   ufd = wp[1]; // [0,1]
+   if( ufd == 0 || (wp = rl_amap_rd(ufd, 2)) == 0 ) {
+      return(-1);
+   }
+   for(i=0;i<8;i++) { clu[i] = wp[(RL_RSTS_CLUMAP>>1) + i]; }
+   if( clu[1] != ufd || clu[0] == 0 || clu[0] > 8 ) {
+      return(-1);
+   }
+   lnk = wp[0]; // Label, link to the first name entry
+   for(n=0;;n++) {
+      if( (lnk & ~017) == 0 || n > 7*8*31 ||
+          (wp = rl_amap_lnk(lnk, clu)) == 0 ) {
+         return(-1); // No SATT.SYS
+      }
+      if( wp[1] == RL_RSTS_SATT0 && wp[2] == RL_RSTS_SATT1 &&
+          wp[3] == RL_RSTS_SYS ) {
+         break;
+      }
+      lnk = wp[0];
+   }
+   lnk = wp[7]; // First retrieval entry
+   if( (wp = rl_amap_lnk(wp[6], clu)) == 0 ) { // Accounting entry
+      return(-1);
+   }
+   fcs = wp[7]; // File cluster size
+   if( fcs == 0 || fcs > 256 || (fcs & (fcs - 1)) ) {
+      return(-1);
+   }
+   // Clear the free pack clusters, as if cluster 0 starts at DCN 0
+   ncl = rl_amap_nblk >> s;
+   cl = 0;
+   while( cl < ncl ) {
+      if( (lnk & ~017) == 0 || (wp = rl_amap_lnk(lnk, clu)) == 0 ) {
+         return(-1); // SATT.SYS ends before the pack does
+      }
+      for(i=0;i<8;i++) { ret[i] = wp[i]; } // Next link, 7 DCNs
+      lnk = ret[0];
+      for(i=1;i<8 && cl<ncl;i++) {
+         for(j=0;j<fcs && cl<ncl;j++) { // One SATT block, 4096 clusters
+            if( ret[i] == 0 || (wp = rl_amap_rd(ret[i] + j, 2)) == 0 ) {
+               return(-1);
+            }
+            for(k=0;k<256 && cl<ncl;k++,cl+=16) { // A word at a time
+               b = wp[k];
+               for(n=0;n<16 && cl+n<ncl;n++,b>>=1) {
+                  if( (b & 1) == 0 ) {
+                     rl_amap_free((cl+n)<<s, pcs);
+                  }
+               }
+            }
+         }
+      }
+   }
+   // If cluster 0 starts at DCN 1 instead, block b is in the cluster that
+   // holds b-1 above. Keep every block either way says is in use.
+   for(b=rl_amap_nblk-1;b>0;b--) {
+      if( rl_amap[(b-1)>>3] & (1<<((b-1) & 7)) ) {
+         rl_amap[b>>3] |= (1<<(b & 7));
+      }
+   }
+   rl_amap[0] |= 3; // Boot block and pack label
+   // The structures just read must be in use, or the SATT was misread
+   if( !RL_AMAP_USED(mfd) || !RL_AMAP_USED(gfd) || !RL_AMAP_USED(ufd) ) {
+      return(-1);
+   }
+   return(0);
+}
+#endif // RLRSTS
+
+// Work out which blocks of the pack in drv are free.
+// Return the RL_AMAP_* file system found, RL_AMAP_NONE sends it all
+int
+rl_amap_init(unsigned int drv)
+{  unsigned int i;
+   rl_sread_stop();
+   rl_wait_dready(drv, 1, 1);
+   rl_amap_drv = drv;
+   rl_amap_nblk = (rlst.type ? RL2_LBAS : RL1_LBAS) >> 1;
+   rl_amap_fmt = RL_AMAP_NONE;
+#ifdef RLRT11
+   for(i=0;i<sizeof(rl_amap);i++) { rl_amap[i] = 0xFF; }
+   if( rl_amap_rt11() == 0 ) {
+      return(rl_amap_fmt = RL_AMAP_RT11);
+   }
+#endif // RLRT11
+#ifdef RLRSTS
+   for(i=0;i<sizeof(rl_amap);i++) { rl_amap[i] = 0xFF; }
+   if( rl_amap_rsts() == 0 ) {
+      return(rl_amap_fmt = RL_AMAP_RSTS);
+   }
+#endif // RLRSTS
+#ifdef RLV7
+   for(i=0;i<sizeof(rl_amap);i++) { rl_amap[i] = 0xFF; }
+   if( rl_amap_v7() == 0 ) { // No signature to go by, so tried last
+      return(rl_amap_fmt = RL_AMAP_V7);
+   }
+#endif // RLV7
+   for(i=0;i<sizeof(rl_amap);i++) { rl_amap[i] = 0xFF; }
+   return(rl_amap_fmt);
+}
+
+// Move rl_off in tb past the blocks that are not sent
+static void
+rl_amap_skip(RLTBUF *tb)
+{  unsigned int blk, size = tb->nsec * RL_SECTOR_BSIZE;
+   while( rl_off < size ) {
+      // Unsigned, the sector number passes 32767 from RL02 cylinder 410
+      blk = ((((unsigned int)tb->cyl<<1) | tb->hed) * RL_SECTORS +
+             tb->sec + ((unsigned int)rl_off >> 8)) >> 1;
+      if( RL_AMAP_USED(blk) ) {
+         return;
+      }
+      rl_off = (rl_off | (RL_AMAP_BSIZE-1)) + 1;
+   }
+}
+#endif // RLAMAP
+
+#ifdef RLV7GET
+// V7 file extraction: rl_v7f_open() follows a path from the root inode
+// through the directories on the pack, then rl_sread_map() hands out that
+// file instead of the pack, a block at a time read into the first track
+// buffer. Holes read as zeros.
+int rl_v7f_on=0;
+static unsigned int rl_v7f_drv;
+static unsigned int rl_v7f_isize, rl_v7f_fsize; // From the superblock
+static unsigned int rl_v7f_addr[RL_V7_NADDR]; // di_addr[] of the open inode
+static unsigned long rl_v7f_size; // Bytes in it
+static unsigned long rl_v7f_pos; // Bytes handed out so far
+static unsigned int rl_v7f_off; // Into the block in rl_tbuf[0]
+static unsigned int rl_v7f_ind[3][RL_V7_NINDIR]; // Indirect block per level
+static unsigned int rl_v7f_indblk[3]; // and its number, 0=none
+
+// Read file system block bno into the first track buffer, return a
+// pointer to it or 0 if unreadable or not a block of the file system
+static char *
+rl_v7f_rd(unsigned int bno)
+{  RLTBUF *tb = &rl_tbuf[0];
+   if( bno >= rl_v7f_fsize ||
+       rl_read_lbapa(rl_v7f_drv, (RL_V7_BLK0 + bno)<<1, 2, TB_PA(tb, 0)) ) {
+      return((char *)0);
+   }
+   return(TB_IO(tb, 0));
+}
+
+// Make inode ino the open one, return its di_mode, 0 if there is none
+static unsigned int
+rl_v7f_iget(unsigned int ino)
+{  unsigned char *ip;
+   unsigned int i, mode;
+   if( ino == 0 || ((ino - 1)>>3) + 2 >= rl_v7f_isize ||
+       (ip = (unsigned char *)rl_v7f_rd(((ino - 1)>>3) + 2)) == 0 ) {
+      return(0);
+   }
+   ip += ((ino - 1) & 7) << 6; // 8 inodes of 64 bytes per block
+   mode = ip[0] | (ip[1]<<8);
+   // di_size is a long, high word first, then 13 three byte addresses
+   // with the high byte first and the low word after it (l3tol())
+   rl_v7f_size = ((unsigned long)(ip[8] | (ip[9]<<8)) << 16) |
+                 (unsigned int)(ip[10] | (ip[11]<<8));
+   for(i=0;i<RL_V7_NADDR;i++) {
+      if( ip[12 + i*3] != 0 ) {
+         return(0); // Past 64K blocks, not on an RL
+      }
+      rl_v7f_addr[i] = ip[13 + i*3] | (ip[14 + i*3]<<8);
+   }
+   for(i=0;i<3;i++) { rl_v7f_indblk[i] = 0; }
+   rl_v7f_pos = 0;
+   rl_v7f_off = RL_V7_BSIZE; // Nothing read yet
+   return(mode);
+}
+
+// File block lbn of the open inode to a file system block, 0=hole
+static unsigned int
+rl_v7f_bmap(unsigned int lbn)
+{  unsigned int bno, lvl, i;
+   unsigned int *wp;
+   if( lbn < 10 ) {
+      return(rl_v7f_addr[lbn]);
+   }
+   lbn -= 10;
+   if( lbn < RL_V7_NINDIR ) {
+      lvl = 0;
+   } else if( (lbn -= RL_V7_NINDIR) < RL_V7_NINDIR*RL_V7_NINDIR ) {
+      lvl = 1;
+   } else {
+      lbn -= RL_V7_NINDIR*RL_V7_NINDIR;
+      lvl = 2;
+   }
+   bno = rl_v7f_addr[10 + lvl];
+   while( 1 ) {
+      if( bno == 0 ) {
+         return(0);
+      }
+      if( rl_v7f_indblk[lvl] != bno ) { // Low words of the 128 longs
+         if( (wp = (unsigned int *)rl_v7f_rd(bno)) == 0 ) {
+            return(0);
+         }
+         for(i=0;i<RL_V7_NINDIR;i++) { rl_v7f_ind[lvl][i] = wp[(i<<1) + 1]; }
+         rl_v7f_indblk[lvl] = bno;
+      }
+      bno = rl_v7f_ind[lvl][(lbn >> (lvl * 7)) & (RL_V7_NINDIR-1)];
+      if( lvl == 0 ) {
+         return(bno);
+      }
+      lvl--;
+   }
+}
+
+// Point *ptr at the next bytes (up to len) of the open file, in the
+// first track buffer, and return how many, 0 at the end of the file
+int
+rl_v7f_map(char **ptr, unsigned int len)
+{  RLTBUF *tb = &rl_tbuf[0];
+   unsigned int bno, n, w;
+   if( rl_v7f_pos >= rl_v7f_size ) {
+      return(0);
+   }
+   if( rl_v7f_off >= RL_V7_BSIZE ) { // On to the next block
+      if( (bno = rl_v7f_bmap((unsigned int)(rl_v7f_pos >> 9))) == 0 ) {
+         for(n=0;n<RL_V7_BSIZE;n++) { *TB_IO(tb, n) = 0; }
+      } else if( rl_v7f_rd(bno) == 0 ) {
+         return(0); // Unreadable, the file ends here
+      }
+      rl_v7f_off = 0;
+   }
+   n = RL_V7_BSIZE - rl_v7f_off;
+   if( n > len ) { n = len; }
+   if( (unsigned long)n > rl_v7f_size - rl_v7f_pos ) {
+      n = (unsigned int)(rl_v7f_size - rl_v7f_pos);
+   }
+   *ptr = TB_RD(tb, rl_v7f_off, &w);
+   if( n > w ) { n = w; }
+   rl_v7f_off += n;
+   rl_v7f_pos += n;
+   return((int)n);
+}
+
+// Look name (len bytes) up in the open directory, return its inode or 0
+static unsigned int
+rl_v7f_lookup(char *name, unsigned int len)
+{  unsigned char *dp;
+   unsigned int i;
+   while( rl_v7f_map((char **)&dp, 16) == 16 ) { // Inode, 14 byte name
+      if( (dp[0] | dp[1]) == 0 ) {
+         continue; // Removed
+      }
+      for(i=0;i<len && dp[2+i]==name[i];i++);
+      if( i == len && (len == RL_V7_DIRSIZ || dp[2+len] == 0) ) {
+         return(dp[0] | (dp[1]<<8));
+      }
+   }
+   return(0);
+}
+
+// Find path on the V7 file system in drv and open it for rl_sread_map().
+// Return 0=OK, -1=not V7, not found or not a plain file
+int
+rl_v7f_open(unsigned int drv, char *path)
+{  unsigned int *wp;
+   unsigned int len, mode;
+   rl_sread_stop();
+   rl_v7f_on = 0;
+   rl_wait_dready(drv, 1, 1);
+   rl_v7f_drv = drv;
+   rl_v7f_fsize = 2; // Enough to read the superblock
+   if( (wp = (unsigned int *)rl_v7f_rd(1)) == 0 ) {
+      return(-1);
+   }
+   rl_v7f_isize = wp[0];
+   rl_v7f_fsize = wp[2];
+   if( wp[1] != 0 || rl_v7f_isize < 3 || rl_v7f_isize >= rl_v7f_fsize ||
+       rl_v7f_fsize > ((rlst.type ? RL2_LBAS : RL1_LBAS) >> 1) - RL_V7_BLK0 ) {
+      return(-1);
+   }
+   mode = rl_v7f_iget(RL_V7_ROOTINO);
+   while( 1 ) {
+      while( *path == '/' ) { path++; }
+      if( *path == 0 ) {
+         break;
+      }
+      for(len=0;path[len] && path[len]!='/';len++);
+      if( (mode & RL_V7_IFMT) != RL_V7_IFDIR ||
+          len > RL_V7_DIRSIZ ) {
+         return(-1);
+      }
+      mode = rl_v7f_iget(rl_v7f_lookup(path, len));
+      path += len;
+   }
+   if( (mode & RL_V7_IFMT) != RL_V7_IFREG ) {
+      return(-1);
+   }
+   rl_v7f_on = 1;
+   return(0);
+}
+#endif // RLV7GET
+
+#ifdef RLRESTORE
+// Restore: the track buffers are filled from the line and written out
+// behind the reader. rl_tcur is filled at rl_off while rl_tnxt is being
+// written (and checked), so the disk works while Kermit receives.
+#define RL_TB_WRITING 4 // Write Data in flight
+#define RL_TB_CHECKING 5 // Write Check in flight
+int rl_wr=0; // 1=The track buffers are used for writing
+int rl_wr_err=0; // 1=A track buffer did not write, or check, after retries
+static int rl_wr_vfy=0; // 1=Write Check every track buffer once written
+static int rl_wr_maxcyl=0;
+static void rl_bcopy(char *dst, char *src, unsigned int n);
+
+// Write (and check) tb, waiting for it, used for the retries
+static void
+rl_write_buf(RLTBUF *tb)
+{
+   rl_xfer_startpa(RL_CMD_WDAT, rlst.drive_num, tb->sec, tb->hed, tb->cyl,
+                   (unsigned int)(tb->nsec * RL_SECTOR_WSIZE), TB_PA(tb, 0));
+   while( ! rl_read_done() );
+   if( rlst.last_error || !rl_wr_vfy ) {
+      return;
+   }
+   rl_xfer_startpa(RL_CMD_WCHK, rlst.drive_num, tb->sec, tb->hed, tb->cyl,
+                   (unsigned int)(tb->nsec * RL_SECTOR_WSIZE), TB_PA(tb, 0));
+   while( ! rl_read_done() );
+}
+
+// Keep the writes going: collect a finished Write Data, follow it with
+// a Write Check when verifying, and start the next full buffer.
+static void
+rl_wahead()
+{  int max_retry = 2;
+   RLTBUF *tb = &rl_tbuf[rl_tnxt];
+   if( tb->state == RL_TB_WRITING || tb->state == RL_TB_CHECKING ) {
+      if( ! rl_read_done() ) {
+         return; // Still transferring
+      }
+      if( !rlst.last_error && tb->state == RL_TB_WRITING && rl_wr_vfy ) {
+         tb->state = RL_TB_CHECKING;
+         rl_xfer_startpa(RL_CMD_WCHK, rlst.drive_num, tb->sec, tb->hed, tb->cyl,
+                         (unsigned int)(tb->nsec * RL_SECTOR_WSIZE), TB_PA(tb, 0));
+         return;
+      }
+      while( rlst.last_error && max_retry ) { // Write it all again
+         rl_wait_dready(rlst.drive_num, 1, 1); // Reset & retry
+#ifdef RLSTATS
+         rlstat.retries++;
+#endif // RLSTATS
+         rl_write_buf(tb);
+         max_retry--;
+      }
+      if( rlst.last_error ) {
+         rl_wr_err = 1; // The sender gets an Error packet
+      }
+      tb->state = RL_TB_EMPTY;
+      if( ++rl_tnxt >= RL_NBUF ) { rl_tnxt = 0; }
+      tb = &rl_tbuf[rl_tnxt];
+   }
+   if( tb->state == RL_TB_FULL ) {
+      tb->state = RL_TB_WRITING;
+      rl_xfer_startpa(RL_CMD_WDAT, rlst.drive_num, tb->sec, tb->hed, tb->cyl,
+                      (unsigned int)(tb->nsec * RL_SECTOR_WSIZE), TB_PA(tb, 0));
+   }
+}
+
+// Get drv ready to be written from cylinder 0, vfy=1 to check each write.
+// Return 0=OK, -1=drive not ready or write locked
+int
+rl_swrite_init(unsigned int drv, int vfy)
+{  int i;
+   rl_sread_stop();
+   rl_wait_dready(drv, 1, 1);
+   if( (rlst.cs_cmd_rtn & RL_CS_CERR) || (rlst.mp_status & RL_MP_STA_WL) ) {
+      return(-1);
+   }
+   rl_wr_maxcyl = rlst.type ? RL2_CYL : RL1_CYL;
+   for(i=0;i<RL_NBUF;i++) { rl_tbuf[i].state = RL_TB_EMPTY; }
+   rl_hed=0;
+   rl_sec=0;
+   rl_cyl=0;
+   rl_off=0;
+   rl_tcur=0;
+   rl_tnxt=0;
+   rl_wr_err=0;
+   rl_wr_vfy=vfy;
+   rl_wr=1;
+   return(0);
+}
+
+// Zero-copy sequential write: point *ptr at the free bytes of the buffer
+// being filled and return how many, waiting for a write to finish when
+// every buffer is full. Return 0 once the end of the pack is reached.
+int
+rl_swrite_map(char **ptr)
+{  RLTBUF *tb = &rl_tbuf[rl_tcur];
+   unsigned int n, w;
+   while( tb->state != RL_TB_EMPTY ) { // The disk is behind the line
+      rl_wahead();
+   }
+   if( rl_off == 0 ) { // New buffer, give it the next disk position
+      if( rl_cyl >= rl_wr_maxcyl ) {
+         return(0); // Pack is full
+      }
+      n = RL_SECTORS - rl_sec;
+      if( n > RL_TRKSECS ) { n = RL_TRKSECS; }
+      tb->sec = rl_sec; tb->hed = rl_hed; tb->cyl = rl_cyl; tb->nsec = n;
+      rl_sec += n;
+      if( rl_sec >= RL_SECTORS ) {
+         rl_sec = 0;
+         if( ++rl_hed > 1 ) { rl_hed = 0; rl_cyl++; }
+      }
    }
-   c++;
-   return(c);
+   *ptr = TB_RD(tb, rl_off, &w);
+   n = (tb->nsec * RL_SECTOR_BSIZE) - rl_off;
+   if( n > w ) { n = w; } // No further than the window reaches
+   return((int)n);
 }
 
-
-#ifdef NOTUSED
-// This subroutine depends on rlst.type which is set by rl_stats()
-RLDSK*
-logical_sec2shc(unsigned int logical_sec)
-{  volatile int s, h, c;
-   s=h=c=(unsigned int)0;
-   if( rlst.type ) {
-      if( logical_sec >= 40960 ) { logical_sec = 40959; } // Max
-   } else {
-      if( logical_sec >= 20480 ) { logical_sec = 20479; } // Max
+// Account for n bytes put in by the caller, a full buffer is queued
+void
+rl_swrite_commit(unsigned int n)
+{  RLTBUF *tb = &rl_tbuf[rl_tcur];
+   rl_off += n;
+   if( rl_off >= (tb->nsec * RL_SECTOR_BSIZE) ) {
+      tb->state = RL_TB_FULL;
+      rl_off = 0;
+      if( ++rl_tcur >= RL_NBUF ) { rl_tcur = 0; }
    }
-
-   c = 0; s = (int)(logical_sec>>4);
-   while( s >= 0x5 ) { s -= 0x5; c++; } // 0x50 = 80 (sec per cyl)
-   s = (int)(logical_sec - ((unsigned int)c*(unsigned int)80));
-   h=0;
-   while( s >= (unsigned int)40 ) { s -= (unsigned int)40; h++; }
-
-   rlst.sector = s;
-   rlst.head = h;
-   rlst.cylinder = c;
-   return(&rlst);
+   rl_wahead();
 }
-#endif // NOTUSED
 
-RLDSK*
-rl_seek(unsigned int drv, unsigned int cyl)
-{
-   volatile unsigned int *ptr = (unsigned int*)RL_DA;
-   int target, current, offset;
-   unsigned int dir;
-   target = (int)cyl;
-   rl_read_hdr();
-   current = rlst.cylinder;
-   offset = target - current; // Signed result for direction +=toward spindle
-   if( offset == 0 ) { return(&rlst); }
-   if( offset >= 0 ) {
-      dir = 1; // toward spindle
-   } else {
-      dir = 0; // away from spindle
+// Copy len bytes to the pack. Bytes past the end of the pack are dropped.
+// Return 0=OK, -1=a write failed
+int
+rl_swrite(char *p, unsigned int len)
+{  char *dp;
+   unsigned int n;
+   while( len > 0 ) {
+      n = rl_swrite_map(&dp);
+      if( n == 0 ) {
+         break; // Pack full
+      }
+      if( n > len ) { n = len; }
+      len -= n;
+      rl_bcopy(dp, p, n);
+      rl_swrite_commit(n);
+      p += n;
    }
-   *ptr = (((unsigned int)offset<<7) & RL_DA_SK_DF) | 
-          (((unsigned int)rlst.head<<4) & RL_DA_SK_HS) | 
-          (((unsigned int)dir<<2) & RL_DA_SK_DIR) |
-          ((unsigned int)0x01);
-   rl_wait_dready(drv, 0, 0);
-   rl_cmd((unsigned int)drv,(unsigned int)RL_CMD_SEEK);
-   rl_read_hdr(); // Update our struct
-   return(&rlst);
+   return(rl_wr_err ? -1 : 0);
 }
 
-RLDSK*
-rl_read(unsigned int drv, unsigned int sec, unsigned int hed, unsigned int cyl, unsigned int words_cnt)
-{
-   volatile unsigned int *ptr = (unsigned int*)RL_BA;
-   unsigned int r, i;
-   long x;
-
-//cons_puts("rl_read: start\n");
-   if( words_cnt > RL_SECTOR_WSIZE ) {
-      cons_puts("ERROR:Larger then one block currently not supported\n\r");
-      return(&rlst); // The limit is our buffer size
+// Write out the partly filled buffer, a sector at a time, and wait for
+// every write to finish. Return 0=OK, -1=a write failed
+int
+rl_swrite_stop()
+{  RLTBUF *tb = &rl_tbuf[rl_tcur];
+   int i;
+   if( rl_off > 0 ) {
+      tb->nsec = (rl_off + RL_SECTOR_BSIZE - 1) >> 8; // Whole sectors
+      while( rl_off < (tb->nsec * RL_SECTOR_BSIZE) ) {
+         *TB_IO(tb, rl_off) = 0; // Rest of the last sector
+         rl_off++;
+      }
+      rl_swrite_commit(0);
    }
-   rl_status(drv, 1);
-   rlst.head = hed;
-//cons_puts("rl_read: seek:");cons_hex((char*)&cyl,2,0);
-   rl_seek(drv,cyl); // Verify cyl location
-   x = twos_comp(13,(long)words_cnt);
-   rlst.rw_word_cnt = (unsigned int)words_cnt;
-   rlst.rw_word_2s = x;
-   //cons_num("MP-X2: ",(unsigned int)x);
-
-   *ptr = (unsigned int)BUF;
+   for(i=0;i<RL_NBUF;i++) { // Wait for the writes still queued
+      while( rl_tbuf[i].state != RL_TB_EMPTY ) {
+         rl_wahead();
+      }
+   }
+   rl_wr=0;
+   return(rl_wr_err ? -1 : 0);
+}
+#endif // RLRESTORE
 
-//cons_puts("rl_read: cyl: ");cons_hex((char*)&cyl,2,0);
-//cons_puts("rl_read: hed: ");cons_hex((char*)&hed,2,0);
-//cons_puts("rl_read: sec: ");cons_hex((char*)&sec,2,0);
-   rl_wait_cready();
-   ptr = (unsigned int*)RL_DA;
-   i = ((cyl<<7) & RL_MP_HDR_CYL) | ((hed<<6) & RL_MP_HDR_HEAD) | (sec & RL_MP_HDR_SEC);
-   *ptr = (unsigned int)i;  // Where to read!
-   //cons_num("Read DA: ",i);
-   rlst.da_reg = *ptr;
+#ifdef RLCOPY
+// Disk to disk copy: the ring is filled from src, then written (and
+// checked) out to dst, RL_NBUF buffers at a time. The position cache
+// follows one drive only, so each drive's is kept here across the
+// switches. Neither drive is reset, and each goes on seeking to the
+// next batch while the other one transfers.
+typedef struct {
+   unsigned int valid;
+   unsigned int cyl;
+   unsigned int hed;
+} RLPOS;
 
-   ptr = (unsigned int*)RL_MP;
-   *ptr = (unsigned int)0160000 | ((unsigned int)(x & 017777));
-   rlst.mp_status = *ptr;
-   ptr = (unsigned int*)RL_CS;
-   rl_wait_dready(drv,0,0); // Wait for it
-   rl_cmd((unsigned int)drv,(unsigned int)RL_CMD_RDAT);
-   rlst.cs_cmd_rtn = *ptr;
-   rlst.last_sector = sec;
-   rlst.last_head = hed;
-   rlst.last_cylinder = cyl;
-   rlst.last_error = rlst.cs_cmd_rtn & RL_CS_ERR;
-//cons_puts("rl_read: return\n");
-   return(&rlst);
+// Leave the drive in use, its heads kept in *from, for drv at *to.
+// CS DRDY shows the drive of the last command, which is the other one and
+// still seeking, so a Get Status selects drv before anything waits on it.
+static void
+rl_copy_pos(RLPOS *from, RLPOS *to, unsigned int drv)
+{
+   from->valid = rlst.pos_valid;
+   from->cyl = rlst.pos_cylinder;
+   from->hed = rlst.pos_head;
+   rlst.pos_valid = to->valid;
+   rlst.pos_cylinder = to->cyl;
+   rlst.pos_head = to->hed;
+   rlst.pos_drive = drv;
+   rlst.drive_num = drv;
+   rl_status(drv, 0);
 }
 
-#ifndef NEWCODE
-// Read next buffer from current disk, and record position
-// 2nd version of rl_fread()
-volatile int rl_hed=0;
-volatile int rl_sec=0;
-volatile int rl_cyl=0;
-volatile int rl_off=0;
-void
-rl_sread_init()
-{
-   rl_status(0, 1); // DBG 2 end tracks, last cyl
-   rl_hed=0;
-   rl_sec=0;
-   rl_cyl=0;
-   rl_off=0;
+// Run fn on tb at drv, waiting for it. Return 0=OK, -1=failed retries
+static int
+rl_copy_xfer(unsigned int fn, unsigned int drv, RLTBUF *tb)
+{  int max_retry = 2;
+   while( 1 ) {
+      rl_xfer_startpa(fn, drv, tb->sec, tb->hed, tb->cyl,
+                      (unsigned int)(tb->nsec * RL_SECTOR_WSIZE), TB_PA(tb, 0));
+      while( ! rl_read_done() );
+      if( !rlst.last_error ) {
+         return(0);
+      }
+      if( max_retry-- == 0 ) {
+         return(-1);
+      }
+      rl_wait_dready(drv, 1, 1); // Reset & retry
+#ifdef RLSTATS
+      rlstat.retries++;
+#endif // RLSTATS
+   }
 }
 
-// Check for current active sector data in buffer
-// Return 0=OK, 1=EOF
+// Copy the pack in src onto dst, each write checked. A '.' goes to the
+// console for every batch. Return 0=OK, -1=failed, rlst.err_msg and
+// rlst.drive_num/last_* tell what and where
 int
-rl_sread_check()
-{  int maxcyl = 512; // Default RL02 with 512 cyl
-   int max_retry = 2;
-   int i;
-   if( rlst.type == 0 ) { // RL01?
-      maxcyl = 256;  // RL01 has only 256 cyl
+rl_copy(unsigned int src, unsigned int dst)
+{  RLPOS spos, dpos;
+   RLTBUF *tb;
+   unsigned int cyl=0, hed=0, sec=0, maxcyl, dtype, i, n, nb;
+   rl_sread_stop();
+   rl_wait_dready(dst, 1, 1);
+   if( (rlst.cs_cmd_rtn & RL_CS_CERR) || (rlst.mp_status & RL_MP_STA_WL) ) {
+      rlst.err_msg = "Destination not ready or write locked";
+      return(-1);
    }
-#ifdef DBG1
-cons_puts("rl_sread_check(A) rl_cyl\n");cons_hex((char*)&rl_cyl,2,0);
-#endif
-   if( rl_cyl >= maxcyl ) {
-#ifdef DBG1
-cons_puts("rl_sread_check(A) END return(1)\n");
-#endif
-      return(1);
+   dtype = rlst.type;
+   rl_wait_dready(src, 1, 1);
+   if( rlst.cs_cmd_rtn & RL_CS_CERR ) {
+      rlst.err_msg = "Source not ready";
+      return(-1);
    }
-#ifdef DBG1
-cons_puts("rl_sread_check(A) rl_hed\n");cons_hex((char*)&rl_hed,2,0);
-cons_puts("rl_sread_check(A) rl_sec\n");cons_hex((char*)&rl_sec,2,0);
-cons_puts("rl_sread_check(A) rl_off\n");cons_hex((char*)&rl_off,2,0);
-#endif
-      
-   if( rl_off >= RL_SECTOR_BSIZE ) { // Have we reached the end of this block?
-      rl_sec++; // Next sector
-      rl_off=0; // Start of a new block in new sector
-#ifdef DBG1
-cons_puts("rl_sread_check(inc) rl_sec\n");cons_hex((char*)&rl_sec,2,0);
-#endif
-      if( rl_sec >= 40 ) { // Sector overflow?
-         rl_hed++; // Carry to Next head-track
-         rl_sec = 0; // Start of new track
-#ifdef DBG1
-cons_puts("rl_sread_check(inc) rl_hed\n");cons_hex((char*)&rl_hed,2,0);
-#endif
-         if( rl_hed > 1 ) { // Head overflow?
-            rl_cyl++; // Carry to Next cylinder
-            rl_hed = 0; // Start of new cyl on head zero
-#ifdef DBG1
-cons_puts("rl_sread_check(inc) rl_cyl\n");cons_hex((char*)&rl_cyl,2,0);
-#endif
-            if( rl_cyl >= maxcyl ) {
-#ifdef DBG1
-cons_puts("rl_sread_check(Ret EOF)\n");
-#endif
-               return(1); // Return EOF flag
-            }
+   if( rlst.type > dtype ) {
+      rlst.err_msg = "RL02 does not fit on an RL01";
+      return(-1);
+   }
+   maxcyl = rlst.type ? RL2_CYL : RL1_CYL;
+   spos.valid = 0;
+   dpos.valid = 0;
+   while( cyl < maxcyl ) {
+      for(nb=0;nb<RL_NBUF && cyl<maxcyl;nb++) { // Lay out the next batch
+         tb = &rl_tbuf[nb];
+         n = RL_SECTORS - sec;
+         if( n > RL_TRKSECS ) { n = RL_TRKSECS; }
+         tb->sec = sec; tb->hed = hed; tb->cyl = cyl; tb->nsec = n;
+         sec += n;
+         if( sec >= RL_SECTORS ) {
+            sec = 0;
+            if( ++hed > 1 ) { hed = 0; cyl++; }
+         }
+      }
+      for(i=0;i<nb;i++) {
+         if( rl_copy_xfer(RL_CMD_RDAT, src, &rl_tbuf[i]) ) {
+            return(-1);
          }
       }
+      if( cyl < maxcyl ) { // Source heads go on while dst is written
+         rlst.head = hed;
+         rl_seek(src, cyl);
+      }
+      rl_copy_pos(&spos, &dpos, dst);
+      for(i=0;i<nb;i++) {
+         if( rl_copy_xfer(RL_CMD_WDAT, dst, &rl_tbuf[i]) ||
+             rl_copy_xfer(RL_CMD_WCHK, dst, &rl_tbuf[i]) ) {
+            return(-1);
+         }
+      }
+      if( cyl < maxcyl ) { // And dst heads while src is read
+         rlst.head = hed;
+         rl_seek(dst, cyl);
+      }
+      rl_copy_pos(&dpos, &spos, src);
+      cons_putc('.');
    }
-   rlst.sector = rl_sec; rlst.head = rl_hed; rlst.cylinder = rl_cyl;
+   return(0);
+}
+#endif // RLCOPY
 
-   // Now check if we have the correct block loaded
-   if( (rlst.last_cylinder != rl_cyl) ||
-             (rlst.last_head != rl_hed) ||
-           (rlst.last_sector != rl_sec) ) { // Needed sector = current?
-      for(i=0;i<RL_SECTOR_BSIZE;i++) { rlst.last_blk[i] = (char)0; }//zero block
-      rlst.sector = rl_sec; rlst.head = rl_hed; rlst.cylinder = rl_cyl;
-      rl_off=0; // Start of a new block
-#ifdef DBG1
-cons_puts("rl_sread_check(B) rl_hed\n");cons_hex((char*)&rl_hed,2,0);
-cons_puts("rl_sread_check(B) rl_sec\n");cons_hex((char*)&rl_sec,2,0);
-cons_puts("rl_sread_check(B) rl_cyl\n");cons_hex((char*)&rl_cyl,2,0);
-cons_puts("rl_sread_check(B) rl_off\n");cons_hex((char*)&rl_off,2,0);
-cons_puts("rl_sread_check(B) rl_read\n");
-#endif
-#ifndef DUMMYBLK
-      rl_read(rlst.drive_num, rlst.sector, rlst.head, rlst.cylinder, (unsigned int) 128);
+// Keep the read-ahead going: collect a finished read and start the next
+// one into a free buffer. Never waits for the disk, so it can be called
+// from anywhere the program has a moment to spare.
+void
+rl_ahead()
+{  int max_retry = 2;
+   int n;
+#ifdef DUMMYBLK
+   int i;
+#endif // DUMMYBLK
+   int maxcyl = 512; // Default RL02 with 512 cyl
+   RLTBUF *tb = &rl_tbuf[rl_tnxt];
+#ifdef RLRESTORE
+   if( rl_wr ) { // Writing, not reading
+      rl_wahead();
+      return;
+   }
+#endif // RLRESTORE
+#ifdef RLINCR
+   if( rl_inc_qn ) { // Manifest tracks still to check, the disk is theirs
+      rl_inc_step();
+      return;
+   }
+#endif // RLINCR
+   if( tb->state == RL_TB_READING ) {
+      if( ! rl_read_done() ) {
+         return; // Still transferring
+      }
+#ifdef RL_RPS
+      if( tb->split && !rlst.last_error ) { // Now the sectors before the wrap
+         n = tb->split;
+         tb->split = 0;
+         rl_xfer_startpa(RL_CMD_RDAT, rlst.drive_num, tb->sec, tb->hed,
+                         tb->cyl, (unsigned int)(n * RL_SECTOR_WSIZE),
+                         TB_PA(tb, 0));
+         return;
+      }
+      tb->split = 0;
+#endif // RL_RPS
       while( rlst.last_error  && max_retry ) { // Any error?
 #ifdef DBG1
-cons_puts("rl_sread_check()ERROR Retry\n");
+cons_puts("rl_ahead()ERROR Retry\n");
 #endif
          rl_wait_dready(rlst.drive_num, 1, 1); // Reset & retry
-         rl_read(rlst.drive_num, rlst.sector, rlst.head, rlst.cylinder, (unsigned int) 128);
+#ifdef RLSTATS
+         rlstat.retries++;
+#endif // RLSTATS
+         rl_read_pa(rlst.drive_num, tb->sec, tb->hed, tb->cyl,
+                    (unsigned int)(tb->nsec * RL_SECTOR_WSIZE), TB_PA(tb, 0));
          max_retry--;
       }
       if( rlst.last_error ) {
 #ifdef DBG1
-cons_puts("rl_sread_check()ERROR FAILURE\n");
+cons_puts("rl_ahead()ERROR FAILURE\n");
 #endif
-         return(1); // Failure! Return EOF
+#ifdef RLBADMAP
+         rl_salvage(tb); // Keep going, mark the sectors that failed
+#else // RLBADMAP
+         tb->state = RL_TB_ERROR; // Failure! Reader sees EOF here
+         rl_feof = 1;
+         return;
+#endif // RLBADMAP
       }
-#else // DUMMYBLK
-      for(i=0;i<RL_SECTOR_BSIZE;i++) {
-         rlst.last_blk[i] = (char) ((i & 0xF) + 'A');
+#ifdef RLDEDUP
+      else if( rl_dup_on && rl_dup_track(tb) ) {
+         tb->state = RL_TB_EMPTY; // Sent before, read the next one into it
+         return;
+      }
+#endif // RLDEDUP
+      tb->state = RL_TB_FULL;
+      if( ++rl_tnxt >= RL_NBUF ) { rl_tnxt = 0; }
+      tb = &rl_tbuf[rl_tnxt];
+   }
+#ifdef RLSTATS
+   if( tb->state == RL_TB_FULL && !rl_full_t0 ) {
+      rl_full_t0 = cktot | 1; // Disk waiting on the line from now
+   } else if( tb->state == RL_TB_EMPTY && rl_full_t0 ) {
+      rlstat.line_ticks += cktot - rl_full_t0;
+      rl_full_t0 = 0;
+   }
+#endif // RLSTATS
+   if( tb->state != RL_TB_EMPTY || rl_feof ) {
+      if( rl_feof && rl_nxt_drv >= 0 ) { // Disk idle, seek the next drive
+         rl_ready_start((unsigned int)rl_nxt_drv);
+         rl_nxt_drv = (-1);
+      }
+#ifndef DUMMYBLK
+      else if( !rl_feof && rl_sec == 0 && rlst.pos_valid &&
+               (rlst.pos_cylinder != rl_cyl || rlst.pos_head != rl_hed)
+#ifdef RLINCR
+               && (!rl_inc_on ||
+                   rl_inc_changed(((unsigned int)rl_cyl<<1) | rl_hed))
+#endif // RLINCR
+             ) {
+         // The next read starts a new track and every buffer is full. Move
+         // the heads there now, so the seek settles while the line drains
+         // the buffers. With a free buffer the seek is issued below.
+         rlst.head = rl_hed;
+         rl_seek(rlst.drive_num, (unsigned int)rl_cyl);
+      }
+#endif // DUMMYBLK
+      return; // No free buffer, or nothing left to read
+   }
+   if( rlst.type == 0 ) { // RL01?
+      maxcyl = 256;  // RL01 has only 256 cyl
+   }
+#ifdef RLINCR
+   if( rl_inc_on && rl_sec == 0 ) { // Pass over the unchanged tracks
+      while( rl_cyl < maxcyl &&
+             !rl_inc_changed(((unsigned int)rl_cyl<<1) | rl_hed) ) {
+         if( ++rl_hed > 1 ) { rl_hed = 0; rl_cyl++; }
+      }
+      if( rl_cyl >= maxcyl ) {
+         rl_feof = 1; // No more changed tracks
+         return;
       }
-      rlst.last_sector = rl_sec;
-      rlst.last_head = rl_hed;
-      rlst.last_cylinder = rl_cyl;
+   }
+#endif // RLINCR
+
+   // Load as many sectors as fit, stopping at the end of the track
+   n = RL_SECTORS - rl_sec;
+   if( n > RL_TRKSECS ) { n = RL_TRKSECS; }
+   tb->sec = rl_sec; tb->hed = rl_hed; tb->cyl = rl_cyl; tb->nsec = n;
+#ifndef DUMMYBLK
+   // rl_xfer_startpa() would busy wait for a seek, so do the seek here
+   // and start the read on a later call, once the heads have settled.
+   if( ! rl_drv_idle() ) {
+      return; // Still seeking
+   }
+   if( rlst.pos_valid && rlst.pos_drive == rlst.drive_num &&
+       (rlst.pos_cylinder != rl_cyl || rlst.pos_head != rl_hed) ) {
+      rlst.head = rl_hed;
+      rl_seek(rlst.drive_num, (unsigned int)rl_cyl);
+      return;
+   }
+#endif // DUMMYBLK
+#ifdef DBG1
+cons_puts("rl_ahead() rl_hed\n");cons_hex((char*)&rl_hed,2,0);
+cons_puts("rl_ahead() rl_sec\n");cons_hex((char*)&rl_sec,2,0);
+cons_puts("rl_ahead() rl_cyl\n");cons_hex((char*)&rl_cyl,2,0);
+#endif
+#ifndef DUMMYBLK
+#ifdef RLBADMAP
+   if( rl_bad_in(rlst.drive_num, rl_cyl, rl_hed, rl_sec, n) ) {
+      rl_salvage(tb); // Known bad sectors here, a bulk read would fail
+      if( ++rl_tnxt >= RL_NBUF ) { rl_tnxt = 0; }
+   } else
+#endif // RLBADMAP
+   rl_ahead_start(tb);
+#else // DUMMYBLK
+   for(i=0;i<(n * RL_SECTOR_BSIZE);i++) {
+      *TB_IO(tb, i) = (char) ((i & 0xF) + 'A');
+   }
+   rlst.last_sector = rl_sec;
+   rlst.last_head = rl_hed;
+   rlst.last_cylinder = rl_cyl;
+   tb->state = RL_TB_FULL;
+   if( ++rl_tnxt >= RL_NBUF ) { rl_tnxt = 0; }
 #endif // DUMMYBLK
+
+   rl_sec += n; // Move the read-ahead position on
+   if( rl_sec >= RL_SECTORS ) { // Sector overflow?
+      rl_hed++; // Carry to Next head-track
+      rl_sec = 0; // Start of new track
+      if( rl_hed > 1 ) { // Head overflow?
+         rl_cyl++; // Carry to Next cylinder
+         rl_hed = 0; // Start of new cyl on head zero
+         if( rl_cyl >= maxcyl ) {
+            rl_feof = 1; // That was the last track
+         }
+      }
    }
+}
+
+// Check for current active sector data in the track buffers
+// Return 0=OK, 1=EOF
+int
+rl_sread_check()
+{  RLTBUF *tb;
+   while( 1 ) {
+      tb = &rl_tbuf[rl_tcur];
+      if( tb->state == RL_TB_FULL ) {
+#ifdef RLAMAP
+         if( rl_amap_on ) {
+            rl_amap_skip(tb); // Free blocks are left out
+         }
+#endif // RLAMAP
+         if( rl_off < (tb->nsec * RL_SECTOR_BSIZE) ) {
+            return(0); // Needed sector is already in the track buffer
+         }
+         tb->state = RL_TB_EMPTY; // Drained, give it back for reading ahead
+         if( ++rl_tcur >= RL_NBUF ) { rl_tcur = 0; }
+         rl_off = 0;
+         tb = &rl_tbuf[rl_tcur];
+      }
+#ifdef RLSTATS
+      rl_wait_t0 = cktot;
+#endif // RLSTATS
+      while( 1 ) { // Wait here only if the read-ahead fell behind
+         rl_ahead();
+         if( tb->state == RL_TB_FULL ) {
+            break;
+         }
+         if( tb->state == RL_TB_ERROR ||
+             (tb->state == RL_TB_EMPTY && rl_feof) ) {
 #ifdef DBG1
-cons_puts("rl_sread_check() normal return\n");
+cons_puts("rl_sread_check(Ret EOF)\n");
 #endif
-   return(0); // Needed sector is now current
+            return(1); // Return EOF flag
+         }
+      }
+#ifdef RLSTATS
+      rlstat.disk_ticks += cktot - rl_wait_t0; // Line waiting on the disk
+#endif // RLSTATS
+      rlst.sector = tb->sec; rlst.head = tb->hed; rlst.cylinder = tb->cyl;
+      rl_ahead(); // Start on the next buffer while this one is drained
+      // Round again, the new buffer may have nothing to send under RLAMAP
+   }
+}
+
+// Zero-copy sequential read: point *ptr at the next bytes (up to len) in
+// the track buffer the RL11 read into, and return how many, 0 at EOF.
+// The bytes stay valid until the next rl_sread_map() or rl_sread() call.
+int
+rl_sread_map(char **ptr, unsigned int len)
+{  RLTBUF *tb;
+   unsigned int n, w;
+#ifdef RLV7GET
+   if( rl_v7f_on ) {
+      return(rl_v7f_map(ptr, len)); // One file off the pack instead
+   }
+#endif // RLV7GET
+   rl_ahead();
+   if( rl_sread_check() ) { // Reached EOF?
+      return(0);
+   }
+   tb = &rl_tbuf[rl_tcur];
+   n = (tb->nsec * RL_SECTOR_BSIZE) - rl_off;
+   if( n > len ) { n = len; }
+#ifdef RLAMAP
+   if( rl_amap_on && n > RL_AMAP_BSIZE - (rl_off & (RL_AMAP_BSIZE-1)) ) {
+      n = RL_AMAP_BSIZE - (rl_off & (RL_AMAP_BSIZE-1)); // To the block end
+   }
+#endif // RLAMAP
+   *ptr = TB_RD(tb, rl_off, &w);
+   if( n > w ) { n = w; } // No further than the window reaches
+   rl_off += n;
+   return((int)n);
+}
+
+// Copy n bytes, a word at a time when both ends are word aligned
+static void
+rl_bcopy(char *dst, char *src, unsigned int n)
+{
+   if( ((unsigned int)dst & 1) == 0 && ((unsigned int)src & 1) == 0 ) {
+      unsigned int *wd = (unsigned int *)dst;
+      unsigned int *ws = (unsigned int *)src;
+      unsigned int w = n >> 1; // 16 bit words
+      while( w-- ) { *wd++ = *ws++; }
+      dst = (char *)wd;
+      src = (char *)ws;
+      n &= 1;
+   }
+   while( n-- ) { *dst++ = *src++; }
 }
 
 // Sequential read to replace the rl_fread()
+// Copies whole spans of the track buffer, the geometry is only looked at
+// when a buffer runs out.
 // Return the number of char copied to output buffer
 int
 rl_sread(char* outptr,unsigned int len)
+{  unsigned int cnt=0;
+   unsigned int n, w;
+   char *sp;
+   RLTBUF *tb;
+   rl_ahead();
+   while( cnt < len ) {
+      if( rl_sread_check() ) { // Check current, reached EOF?
+#ifdef DBG1
+cons_puts("rl_sread() Return EOF\n");cons_hex((char*)&cnt,2,0);
+#endif
+         return(cnt); // We have reached the EOF
+      }
+      tb = &rl_tbuf[rl_tcur];
+      n = (tb->nsec * RL_SECTOR_BSIZE) - rl_off; // Rest of this buffer
+      if( n > (len - cnt) ) { n = len - cnt; }
+#ifdef RLAMAP
+      if( rl_amap_on && n > RL_AMAP_BSIZE - (rl_off & (RL_AMAP_BSIZE-1)) ) {
+         n = RL_AMAP_BSIZE - (rl_off & (RL_AMAP_BSIZE-1)); // To the block end
+      }
+#endif // RLAMAP
+      sp = TB_RD(tb, rl_off, &w);
+      if( n > w ) { n = w; }
+      rl_bcopy(&outptr[cnt], sp, n);
+      rl_off += n;
+      cnt += n;
+   }
+#ifdef DBG1
+cons_puts("rl_sread() cnt\n");cons_hex((char*)&cnt,2,0);
+#endif
+   return(cnt);
+}
+
+#ifdef RLBENCH
+// The byte at a time rl_sread() it replaced, kept to compare timings
+int
+rl_sread_bytewise(char* outptr,unsigned int len)
 {  int i;
    volatile unsigned int cnt=0;
    volatile char *dst;
    dst = outptr;
    for(i=0;i<len;i++) { outptr[i]=(char)0; } // Zero buffer
+   rl_ahead();
    while( cnt < len ) {
       if( rl_sread_check() ) { // Check current, reached EOF?
-#ifdef DBG1
-cons_puts("rl_sread() Return EOF\n");cons_hex((char*)&cnt,2,0);
-#endif
          return(cnt); // We have reached the EOF
       }
 
-      *dst = rlst.last_blk[rl_off++]; // Copy one char, inc src pos
+      *dst = *TB_IO(&rl_tbuf[rl_tcur], rl_off); // Copy one char
+      rl_off++; // inc src pos
       dst++;
       cnt++;
    }
-#ifdef DBG1
-cons_puts("rl_sread() cnt\n");cons_hex((char*)&cnt,2,0);
-#endif
    return(cnt);
 }
+#endif // RLBENCH
 #endif // NEWCODE
 
 #ifdef NOTUSED
@@ -384,7 +2135,7 @@ rl_read_hdr()
    rl_wait_cready();
    rl_cmd(rlst.drive_num,(unsigned int)RL_CMD_RHDR);
    mpv = *rp;
-   rlst.sector = mpv & (unsigned int)RL_MP_STA_DRV;
+   rlst.sector = mpv & (unsigned int)RL_MP_HDR_SEC;
    rlst.head = ((mpv & (unsigned int)RL_MP_HDR_HEAD)>>6) & 1;
    rlst.cylinder = ((mpv & (unsigned int)RL_MP_HDR_CYL)>>7) & 0777;
    return(&rlst);
@@ -392,19 +2143,78 @@ rl_read_hdr()
 
 RLDSK*
 rl_cmd(unsigned int drv, unsigned int cmd)
+{
+   rl_cmd_ba(drv, cmd, (char*)BUF);
+   return(&rlst);
+}
+
+// Load BA with the low 16 bits of the physical address pa, and BAE with
+// bits 16-21 on an RLV12. Return bits 16-17 placed for the CS BA17/BA16
+// field, the RL11 gets them with the command.
+static unsigned int
+rl_set_ba(unsigned long pa)
 {
    volatile unsigned int *rp = (unsigned int*)RL_BA;
-   *rp = (unsigned int)BUF;
-   rp = (unsigned int*)RL_CS;
+   *rp = (unsigned int)pa;
+#ifdef RLV12
+   rp = (unsigned int*)RL_BAE;
+   *rp = (unsigned int)(pa>>16) & 077;
+#endif // RLV12
+   return((unsigned int)(pa>>12) & RL_CS_BA17);
+}
+
+// Same as rl_cmd() but DMA to/from buf instead of the last_blk buffer
+RLDSK*
+rl_cmd_ba(unsigned int drv, unsigned int cmd, char *buf)
+{
+   return(rl_cmd_pa(drv, cmd, RL_PA(buf)));
+}
+
+// Same again with the 18 bit (22 bit RLV12) physical address pa
+RLDSK*
+rl_cmd_pa(unsigned int drv, unsigned int cmd, unsigned long pa)
+{
+   volatile unsigned int *rp = (unsigned int*)RL_CS;
+   unsigned int bx;
+   rl_wait_cready(); // Never move BA under a transfer still running
+   bx = rl_set_ba(pa);
    rlst.drive_num = drv;
    rlst.cmd = cmd;
-   rl_wait_cready();
-   *rp = ((rlst.drive_num<<8) & (unsigned int)RL_CS_DSEL) | ( rlst.cmd & (unsigned int)RL_CS_CMD );
+   rlst.cmd_cnt[(cmd & RL_CS_CMD)>>1]++;
+   *rp = ((rlst.drive_num<<8) & (unsigned int)RL_CS_DSEL) | ( rlst.cmd & (unsigned int)RL_CS_CMD ) | bx;
    rl_wait_cready();
    rlst.err_msg = rl_decode_err(rlst.cs_cmd_rtn);
    return(&rlst);
 }
 
+// Issue cmd with the interrupt enabled and return at once, rlint()
+// clears rl_busy when the controller is done
+RLDSK*
+rl_cmd_start(unsigned int drv, unsigned int cmd, char *buf)
+{
+   return(rl_cmd_startpa(drv, cmd, RL_PA(buf)));
+}
+
+RLDSK*
+rl_cmd_startpa(unsigned int drv, unsigned int cmd, unsigned long pa)
+{
+#ifndef NORLINTR
+   volatile unsigned int *rp = (unsigned int*)RL_CS;
+   unsigned int bx;
+   rl_wait_cready(); // Never move BA under a transfer still running
+   bx = rl_set_ba(pa);
+   rlst.drive_num = drv;
+   rlst.cmd = cmd;
+   rlst.cmd_cnt[(cmd & RL_CS_CMD)>>1]++;
+   rl_busy = 1;
+   *rp = ((rlst.drive_num<<8) & (unsigned int)RL_CS_DSEL) | 
+         ( rlst.cmd & (unsigned int)RL_CS_CMD ) | RL_CS_INT | bx;
+#else // NORLINTR
+   rl_cmd_pa(drv, cmd, pa);
+#endif // NORLINTR
+   return(&rlst);
+}
+
 RLDSK*
 rl_wait_cready()
 {
@@ -419,6 +2229,9 @@ RLDSK*
 rl_status(unsigned int drv, int reset_fg)
 {
    volatile unsigned int *rp=(unsigned int *)RL_DA;
+   if( reset_fg || drv != rlst.pos_drive ) {
+      rlst.pos_valid = 0; // Heads must be found again with Read Header
+   }
    if( reset_fg ) {
       *rp = 013; // Marker=1, GetStatus=1, 0, Reset=1
    } else {
@@ -449,6 +2262,12 @@ rl_wait_dready(unsigned int drv, int status_fg, int reset_fg)
          rl_status(drv,1);
       }
    }
+#ifdef RLSTATS
+   if( rl_seek_on ) { // Heads have arrived
+      rl_hist(rlstat.seek_ticks, cktot - rl_seek_t0);
+      rl_seek_on = 0;
+   }
+#endif // RLSTATS
    rlst.mp_status = *rp;
    return(&rlst);
 }
@@ -526,3 +2345,60 @@ rl_decode_state(unsigned int mp_val)
    }
    return(msg);
 }
+
+#ifdef RLSTATS
+static char *rl_cmd_names[] = { "NoOp:", "Write Check:", "Get Status:",
+   "Seek:", "Read Header:", "Write Data:", "Read Data:", "Read No Hdr:" };
+
+static char *rl_hist_names[RL_HIST] = { "  0:", "  1:", "  2-3:",
+   "  4-7:", "  8-15:", "  16-31:", "  32-63:", "  64+:" };
+
+static void
+rl_hist_dump(char *title, unsigned int *h)
+{  int i;
+   cons_puts("\n");
+   cons_puts(title);
+   for(i=0;i<RL_HIST;i++) {
+      if( h[i] ) {
+         cons_lnum(rl_hist_names[i],(unsigned long)h[i]);
+      }
+   }
+}
+
+// Print the controller commands issued so far, by function code, then
+// the rest of rlstat. More disk_ticks than line_ticks means the backup
+// is disk-bound, the other way round it is line-bound.
+void
+rl_cmd_stats()
+{  int i;
+   unsigned long tot = 0L;
+   for(i=0;i<8;i++) {
+      cons_lnum(rl_cmd_names[i],rlst.cmd_cnt[i]);
+      tot += rlst.cmd_cnt[i];
+   }
+   cons_lnum("Total commands:",tot);
+   rl_hist_dump("Seek cylinders:", rlstat.seek_dist);
+   rl_hist_dump("Seek ticks:", rlstat.seek_ticks);
+   rl_hist_dump("Transfer ticks:", rlstat.xfer_ticks);
+   cons_lnum("Retries:",rlstat.retries);
+   for(i=1;i<16;i++) {
+      if( rlstat.errs[i] ) {
+         cons_lnum(rl_decode_err((unsigned int)(i<<10) | RL_CS_CERR),
+                   (unsigned long)rlstat.errs[i]);
+      }
+   }
+   cons_lnum("Drive errors:",(unsigned long)rlstat.drv_errs);
+   cons_lnum("Ticks line waited on disk:",rlstat.disk_ticks);
+   cons_lnum("Ticks disk waited on line:",rlstat.line_ticks);
+}
+
+// Start counting again from zero
+void
+rl_stats_clear()
+{  int i;
+   char *p = (char *)&rlstat;
+   for(i=0;i<sizeof(rlstat);i++) { p[i] = 0; }
+   for(i=0;i<8;i++) { rlst.cmd_cnt[i] = 0L; }
+   rl_full_t0 = 0;
+}
+#endif // RLSTATS
@@ -49,6 +49,12 @@
 #define RL_BAE 0174410 // BAE=Bus Addresses Extension (RLV12 only, upper 6 bits of 22)
 #define RL_VEC 0160 // Vector
 
+// DMA addresses are physical, 18 bits on the RL11 (BA plus CS BA17/BA16)
+// and 22 bits on the RLV12 (BA plus BAE). Define RLV12 to load BAE, an
+// RL11 has no such register and would trap. RL_PA() gives the physical
+// address of a buffer in the program, which runs unmapped in the low 64KB.
+#define RL_PA(p) ((unsigned long)(unsigned int)(p))
+
 #define RL_CS_DRDY 0x0001 // CS mask for DRDY (Drive Ready)
 #define RL_CS_CMD 0x000E // CS mask for Function Command
 #define RL_CMD_NOOP 0x0000 // CMD = NoOp or Maint mode
@@ -103,6 +109,71 @@
 #define RL_SECTOR_BSIZE (RL_SECTOR_WSIZE*2) // Block size in bytes
 #define RL1_CYL 256 // Total cylinders for RL01
 #define RL2_CYL 512 // Total cylinders for RL02 cyl=0-40959 (0-0x4FFF)
+#define RL1_LBAS 20480 // Logical sectors on an RL01, 256cyl*2hed*40sec
+#define RL2_LBAS 40960 // Logical sectors on an RL02
+#define RL_TRACK_WSIZE (RL_SECTORS*RL_SECTOR_WSIZE) // 5120 words, one track
+
+// Define RLMMU on a machine with a KT11 and more than 64KB ("set cpu 256k"
+// in pdp11.ini). The track buffers then move to physical memory above the
+// program from RL_CACHE_PA, and become a cache of whole tracks that the
+// read-ahead can fill cylinders in front of the serial line.
+// An RL11 on the Unibus reaches 0760000 (248KB) with the Unibus map off.
+#ifdef RLMMU
+#ifndef RL_TRKSECS
+#define RL_TRKSECS 40
+#endif
+#ifndef RL_NBUF
+#define RL_NBUF 16 // 160KB, 8 cylinders
+#endif
+#ifndef RL_CACHE_PA
+#define RL_CACHE_PA 0200000L // 64KB, clear of everything the program maps
+#endif
+#endif // RLMMU
+
+// Sectors fetched by one Read Data into the sequential reader track buffer.
+// A full track (40) is 10KB, which does not fit the 32K pdp11.ini memory
+// next to the Kermit buffers, so the default reads a quarter track.
+#ifndef RL_TRKSECS
+#define RL_TRKSECS 10
+#endif
+#define RL_TRKBUF_BSIZE (RL_TRKSECS*RL_SECTOR_BSIZE)
+
+// Number of track buffers the sequential reader keeps reading ahead into.
+// RL_BUF_BUDGET is the memory set aside for them in the 32K machine. The
+// original ek loaded at 02000 and ran to 32092 (text 12118, data 18950,
+// read from its a.out). 12K of the data was platform.h's file buffers.
+// Those are now 512 bytes each, which gives back 11264 bytes. The rest
+// are APPROXIMATE, from host compiles scaled to the ek figures and not
+// from a size of the PDP-11 builds. The two buffers here, with the
+// read-ahead and encoder code, take about 8K of those bytes, so the
+// default build ends near 29200 with some 3.5K free. Builds with big
+// tables of their own (alloc, v7get in the makefile) use RLMMU. Check
+// with pdp11-aout-size after changing any of this. Raise the budget
+// along with "set cpu" in pdp11.ini for bigger configurations.
+#ifndef RL_NBUF
+#define RL_NBUF 2
+#endif
+#ifndef RL_BUF_BUDGET
+#define RL_BUF_BUDGET 5120
+#endif
+#ifdef RLMMU
+#if (RL_CACHE_PA + (RL_NBUF * RL_TRKBUF_BSIZE)) > 0760000L
+#error "RL_NBUF track buffers from RL_CACHE_PA run into the I/O page"
+#endif
+#else // RLMMU
+#if (RL_NBUF * RL_TRKBUF_BSIZE) > RL_BUF_BUDGET
+#error "RL_NBUF track buffers of RL_TRKSECS sectors exceed RL_BUF_BUDGET"
+#endif
+#endif // RLMMU
+
+// Define RL_RPS to have each track buffer read start at the sector coming
+// under the head (found with Read Header) and wrap round for the rest, so a
+// late start never costs a full revolution. Best with RL_TRKSECS=40.
+//
+// Read Data No Header Check (RL_CMD_RDNC) is not used for the reads. It
+// starts at the next sector pulse whatever sector DA names, so only a
+// Read Header just before it could place it. That costs the command it
+// was meant to save, one per buffer.
 
 typedef struct RLdsk {
    unsigned int drive_num;
@@ -121,6 +192,11 @@ typedef struct RLdsk {
    unsigned int mp_status;
    unsigned int da_reg;
    unsigned long chridx;
+   unsigned int pos_valid; // 1=pos_* match the heads, no Read Header needed
+   unsigned int pos_drive;
+   unsigned int pos_head;
+   unsigned int pos_cylinder;
+   unsigned long cmd_cnt[8]; // Commands issued, index is function code/2
    char *err_msg;
    char *drv_state;
    char last_blk[RL_SECTOR_BSIZE+2]; // One block of 128words or 256bytes
@@ -128,15 +204,226 @@ typedef struct RLdsk {
 
 RLDSK *logical_sec2shc(unsigned int logical_sec);
 RLDSK *rl_cmd(unsigned int, unsigned int);
+RLDSK *rl_cmd_ba(unsigned int, unsigned int, char *);
+RLDSK *rl_cmd_pa(unsigned int, unsigned int, unsigned long);
+RLDSK *rl_cmd_start(unsigned int, unsigned int, char *);
+RLDSK *rl_cmd_startpa(unsigned int, unsigned int, unsigned long);
 RLDSK *rl_wait_cready(void);
 RLDSK *rl_wait_dready(unsigned int drv, int status_fg, int reset_fg);
 RLDSK *rl_seek(unsigned int drv, unsigned int cyl);
 RLDSK *rl_read(unsigned int drv, unsigned int sec, unsigned int hed, unsigned int cyl, unsigned int words_cnt);
+RLDSK *rl_read_buf(unsigned int drv, unsigned int sec, unsigned int hed, unsigned int cyl, unsigned int words_cnt, char *buf);
+RLDSK *rl_read_start(unsigned int drv, unsigned int sec, unsigned int hed, unsigned int cyl, unsigned int words_cnt, char *buf);
+RLDSK *rl_xfer_start(unsigned int fn, unsigned int drv, unsigned int sec, unsigned int hed, unsigned int cyl, unsigned int words_cnt, char *buf);
+RLDSK *rl_xfer_startpa(unsigned int fn, unsigned int drv, unsigned int sec, unsigned int hed, unsigned int cyl, unsigned int words_cnt, unsigned long pa);
+RLDSK *rl_read_pa(unsigned int drv, unsigned int sec, unsigned int hed, unsigned int cyl, unsigned int words_cnt, unsigned long pa);
+int rl_read_done(void);
+int rl_next_sector(unsigned int drv, unsigned int hed, unsigned int cyl);
+int rl_read_lba(unsigned int drv, unsigned int lba, unsigned int count, char *buf);
+int rl_read_lbapa(unsigned int drv, unsigned int lba, unsigned int count, unsigned long pa);
+void rlint(void);
 RLDSK *rl_read_hdr(void);
 RLDSK *rl_status(unsigned int drv, int reset_fg);
 char *rl_decode_err(unsigned int);
 char *rl_decode_state(unsigned int);
 int rl_fread(char* outptr,unsigned int len);
+void rl_sread_init(void);
+void rl_sread_stop(void);
+void rl_ahead(void);
+void rl_sread_next(int drv);
+int rl_ready_start(unsigned int drv);
+int rl_sread(char* outptr,unsigned int len);
+int rl_sread_map(char **ptr, unsigned int len);
+int rl_sread_bytewise(char* outptr,unsigned int len);
+void rl_cmd_stats(void);
+#ifdef RLSTATS
+// Counters for a whole session, dumped by rl_cmd_stats(). Times are in
+// clock ticks (cktot, 1/60 sec), histograms count by powers of two.
+#define RL_HIST 8 // Histogram buckets: 0, 1, 2-3, ... 32-63, 64 and up
+typedef struct RLstat {
+   unsigned int seek_dist[RL_HIST]; // Cylinders moved per seek
+   unsigned int seek_ticks[RL_HIST]; // Seek issued until drive ready
+   unsigned int xfer_ticks[RL_HIST]; // Read/Write/Check Data, start to end
+   unsigned int errs[16]; // Errors by RL_CS_ERR code (CS bits 10-13)
+   unsigned int drv_errs; // RL_CS_DERR seen
+   unsigned long retries; // Transfers done again after an error
+   unsigned long disk_ticks; // Reader waiting for the read-ahead
+   unsigned long line_ticks; // Read-ahead waiting for a free buffer
+} RLSTAT;
+extern RLSTAT rlstat;
+void rl_stats_clear(void);
+#endif // RLSTATS
+#ifdef RLMMU
+void rl_mmu_init(void);
+#endif // RLMMU
+#ifdef RLRESTORE
+extern int rl_wr;
+extern int rl_wr_err;
+int rl_swrite_init(unsigned int drv, int vfy);
+int rl_swrite_map(char **ptr);
+void rl_swrite_commit(unsigned int n);
+int rl_swrite(char *p, unsigned int len);
+int rl_swrite_stop(void);
+#endif // RLRESTORE
+
+#ifdef RLCOPY
+int rl_copy(unsigned int src, unsigned int dst);
+#endif // RLCOPY
+
+#if defined(RLV7) || defined(RLRT11) || defined(RLRSTS)
+#define RLAMAP // Allocation aware backup, the free blocks are left out
+#endif
+#ifdef RLAMAP
+#if defined(RLINCR) || defined(RLDEDUP)
+#error "RLV7/RLRT11/RLRSTS leave blocks out, not with RLINCR or RLDEDUP"
+#endif
+#if RL_TRKSECS & 1
+#error "RLAMAP needs an even RL_TRKSECS, a block is two sectors"
+#endif
+#define RL_AMAP_BSIZE 512 // Block, two sectors
+#define RL_AMAP_USED(b) (rl_amap[(b)>>3] & (1<<((b) & 7)))
+#define RL_AMAP_NONE 0 // Nothing known, the whole pack is sent
+#define RL_AMAP_V7 1
+#define RL_AMAP_RT11 2
+#define RL_AMAP_RSTS 3
+// Unix V7
+#define RL_V7_NICFREE 50 // Free block numbers held in each list block
+#ifndef RL_V7_BLK0
+#define RL_V7_BLK0 0 // Pack block the file system starts at
+#endif
+// RT-11, home block offsets and directory entry status
+#define RL_RT11_DSSEG 0724 // First directory segment block
+#define RL_RT11_SYSID 0760 // "DECRT11A"
+#define RL_RT11_MAXSEG 31
+#define RL_RT11_TENT 0000400 // Tentative file
+#define RL_RT11_MPTY 0001000 // Empty area
+#define RL_RT11_PERM 0002000 // Permanent file
+#define RL_RT11_EOS  0004000 // End of segment
+// RSTS/E, directory blocks and the [0,1]SATT.SYS name in Radix-50
+#define RL_RSTS_CLUMAP 0760 // Cluster map, last blockette of each block
+#define RL_RSTS_LNKOFF 0760 // Link word blockette bits, byte offset
+#define RL_RSTS_SATT0 30460 // "SAT"
+#define RL_RSTS_SATT1 32000 // "T  "
+#define RL_RSTS_SYS 31419 // "SYS"
+extern unsigned char rl_amap[];
+extern unsigned int rl_amap_nblk;
+extern unsigned int rl_amap_drv;
+extern int rl_amap_on;
+extern int rl_amap_fmt;
+int rl_amap_init(unsigned int drv);
+#endif // RLAMAP
+
+#ifdef RLV7GET
+// Unix V7 file extraction, "rlN:/path" streams one file off the pack
+#ifdef RLINCR
+#error "RLV7GET and RLINCR both start with a file from the host, use one"
+#endif
+#ifndef RL_V7_BLK0
+#define RL_V7_BLK0 0 // Pack block the file system starts at
+#endif
+#define RL_V7_BSIZE 512
+#define RL_V7_NADDR 13 // di_addr[], 10 direct then 1, 2 and 3 level indirect
+#define RL_V7_NINDIR 128 // Block numbers in an indirect block
+#define RL_V7_IFMT 0170000
+#define RL_V7_IFDIR 0040000
+#define RL_V7_IFREG 0100000
+#define RL_V7_DIRSIZ 14 // Name bytes in a directory entry
+#define RL_V7_ROOTINO 2
+#define GET_MAX 8 // Files on the host's .get list per session
+extern int rl_v7f_on;
+int rl_v7f_open(unsigned int drv, char *path);
+int rl_v7f_map(char **ptr, unsigned int len);
+#endif // RLV7GET
+
+#ifdef RLBADMAP
+// Degraded mode bad sector map
+#ifndef RL_BADMAX
+#define RL_BADMAX 64 // Sectors the map can hold
+#endif
+#ifndef RL_BAD_TRIES
+#define RL_BAD_TRIES 4 // Reads of a failing sector before it is marked bad
+#endif
+#ifndef RL_BAD_TICKS
+#define RL_BAD_TICKS 60 // Or this many clock ticks, whichever comes first
+#endif
+#define RL_BAD_FILL "BADSECT!" // Fills a bad sector, length a power of 2
+#define RL_BAD_KNOWN 1 // From the DEC STD 144 table, never read
+#define RL_BAD_FOUND 2 // Failed every read in this session
+
+typedef struct RLbad {
+   unsigned int cyl;
+   unsigned char drv;
+   unsigned char hed;
+   unsigned char sec;
+   unsigned char how; // RL_BAD_KNOWN or RL_BAD_FOUND
+} RLBAD;
+
+extern RLBAD rl_bad[];
+extern int rl_nbad;
+int rl_bad_find(unsigned int drv, unsigned int cyl, unsigned int hed, unsigned int sec);
+void rl_bad_add(unsigned int drv, unsigned int cyl, unsigned int hed, unsigned int sec, unsigned int how);
+int rl_bad_in(unsigned int drv, unsigned int cyl, unsigned int hed, unsigned int sec, unsigned int n);
+void rl_bad_load(unsigned int drv);
+#endif // RLBADMAP
+
+#if defined(RLINCR) || defined(RLDEDUP)
+#define RL_TRACKS (RL2_CYL*2) // Tracks on the largest pack, cyl*2+head
+#define RL_CRC_INIT 0xFFFF // CRC-16/CCITT, polynomial 0x1021
+unsigned int rl_crc(unsigned int crc, char *p, unsigned int n);
+#endif // RLINCR || RLDEDUP
+
+#ifdef RLINCR
+// Incremental backup, send only the tracks the host manifest disagrees with
+extern unsigned int rl_inc_drv;
+extern int rl_inc_on;
+#ifndef RL_INC_QLEN
+#define RL_INC_QLEN 128 // Manifest CRCs waiting to be checked, a full obuf
+#endif
+void rl_inc_init(unsigned int drv);
+void rl_inc_track(unsigned int crc);
+int rl_inc_step();
+void rl_inc_flush();
+int rl_inc_changed(unsigned int trk);
+#endif // RLINCR
+
+#ifdef RLDEDUP
+// Cross-drive dedup, a track sent before in the session is only listed
+#if RL_TRKSECS != RL_SECTORS
+#error "RLDEDUP needs whole track buffers, RL_TRKSECS=40 (RLMMU)"
+#endif
+#ifdef RLINCR
+#error "RLDEDUP and RLINCR both leave tracks out, use one"
+#endif
+// RLMMU puts the track buffers above 64K, so the tables below take their
+// RL_BUF_BUDGET instead, at 4 bytes for each track remembered and each
+// duplicate kept. With the 5120 byte default that is 1024 tracks, one
+// RL02 pack, and 256 duplicates. When either fills a note goes to the
+// console and the tracks after it are sent in full.
+#ifndef RL_DUP_FPS
+#if RL_BUF_BUDGET >= 10240
+#define RL_DUP_FPS 2048 // Tracks remembered, a power of 2
+#else
+#define RL_DUP_FPS 1024
+#endif
+#endif
+#ifndef RL_DUP_MAX
+#define RL_DUP_MAX ((RL_BUF_BUDGET - (RL_DUP_FPS * 4)) / 4) // Duplicates kept
+#endif
+#if ((RL_DUP_FPS * 4) + (RL_DUP_MAX * 4)) > RL_BUF_BUDGET
+#error "RL_DUP_FPS and RL_DUP_MAX tables exceed RL_BUF_BUDGET"
+#endif
+#ifndef RL_DUP_SECS
+#define RL_DUP_SECS 4 // Sectors per compare read, divides RL_SECTORS
+#endif
+typedef struct {
+   unsigned int trk; // (drv<<10)|(cyl*2+head) left out
+   unsigned int ref; // Same bytes as this one, sent before
+} RLDUP;
+extern int rl_dup_on;
+extern RLDUP rl_dup[];
+extern int rl_ndup;
+void rl_dup_init(void);
+#endif // RLDEDUP
 
 // RLDSK *rltr; /* Pointer to RLdsk struct */
 #endif
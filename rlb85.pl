@@ -0,0 +1,52 @@
+#!/usr/bin/perl
+#
+# Host side of the BASE85 encoding.
+#
+#  rlb85.pl rl0.b85 > rl0.dsk
+#     Decode an image ek sent in base85 back to the raw image. The result
+#     can then be given to rlinc.pl, rldup.pl or rlmap.pl like a binary one.
+#     Anything that is not a digit or 'z' (CR, LF, ...) is skipped.
+
+my($ALPHA) = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxy".
+             "!\$%()*+-./:;<=>?\@[]^_{|}"; # Same as base85_tbl in pdp11io.c
+my(%val, $i);
+for($i=0;$i<length($ALPHA);$i++) {
+   $val{substr($ALPHA, $i, 1)} = $i;
+}
+
+sub group { # 5 digits to 4 bytes, most significant first
+   my(@d) = @_;
+   my($n, $x) = (0);
+   foreach $x (@d) {
+      $n = $n * 85 + $x;
+   }
+   die "bad base85 group\n" if( $n > 0xFFFFFFFF );
+   return(pack("N", $n));
+}
+
+die "usage: rlb85.pl rl0.b85 > rl0.dsk\n" if( @ARGV != 1 );
+open(F, "<", $ARGV[0]) || die "$ARGV[0]: $!\n";
+binmode(F);
+binmode(STDOUT);
+my(@d, $c, $buf);
+while( read(F, $buf, 65536) ) {
+   foreach $c (split(//, $buf)) {
+      if( $c eq 'z' ) {
+         die "$ARGV[0]: 'z' inside a group\n" if( @d );
+         print "\0\0\0\0";
+      } elsif( exists($val{$c}) ) {
+         push(@d, $val{$c});
+         if( @d == 5 ) {
+            print group(@d);
+            @d = ();
+         }
+      }
+   }
+}
+close(F);
+if( @d ) { # Short last group, n+1 digits for n bytes
+   my($n) = scalar(@d) - 1;
+   die "$ARGV[0]: ends with a single digit\n" if( $n < 1 );
+   push(@d, 84) while( @d < 5 );
+   print substr(group(@d), 0, $n);
+}
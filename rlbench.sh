@@ -0,0 +1,14 @@
+#!/bin/sh
+# Full RL02 pass under SIMH with the default reader and with RL_RPS (start
+# each read at the sector under the head), printing the clock ticks and the
+# RL11 commands each one took. Needs the SIMH pdp11 simulator in the PATH
+# and rawRL02.dsk.
+SIMH=${SIMH:-pdp11}
+for opt in "" "-DRL_RPS"; do
+   make clean > /dev/null
+   make "RLFLAGS=-DRLBENCH -DRLSTATS -DRLBENCH_HALT -DRLBENCH_SECS=40960L $opt" pdp11 > /dev/null || exit 1
+   rm -f rlbench.txt
+   $SIMH rlbench.ini > /dev/null 2>&1
+   echo "==== ${opt:-default}"
+   cat rlbench.txt
+done
@@ -0,0 +1,72 @@
+#!/usr/bin/perl
+#
+# Host side of the RLDEDUP cross-drive dedup.
+#
+#  rldup.pl rldup.txt rl0.b64 rl1.b64 ...
+#     Put the images ek sent back together, each one as rlN.dsk. Give them
+#     in the order they were sent. Each track listed in rldup.txt as
+#     "rlN cyl C head H = rlM cyl D head J" was left out of the rlN image
+#     and is copied from track D/J of the rlM one, which is always rebuilt
+#     first. The images may be binary (BINARYSAFE build) or base64.
+
+use MIME::Base64;
+
+my($TRACK) = 40*256; # 40 sectors of 256 bytes
+
+sub slurp {
+   my($f) = @_;
+   my($d);
+   open(F, "<", $f) || die "$f: $!\n";
+   binmode(F);
+   local $/;
+   $d = <F>;
+   close(F);
+   return($d);
+}
+
+die "usage: rldup.pl rldup.txt rl0.b64 rl1.b64 ...\n" if( @ARGV < 2 );
+
+my(%dup, %img, $l);
+open(D, "<", $ARGV[0]) || die "$ARGV[0]: $!\n";
+while( ($l=<D>) ) {
+   if( $l =~ /rl(\d)\s+cyl\s+(\d+)\s+head\s+(\d+)\s*=\s*rl(\d)\s+cyl\s+(\d+)\s+head\s+(\d+)/ ) {
+      $dup{$1}{$2*2 + $3} = [ $4, $5*2 + $6 ];
+   }
+}
+close(D);
+shift(@ARGV);
+
+my($f);
+foreach $f (@ARGV) {
+   my($drv) = ($f =~ /rl([0-3])[^\/]*$/) ? $1 : 0; # rldisk01.b64 is drive 0
+   my($data) = slurp($f);
+   if( $data =~ /^[A-Za-z0-9+\/=\r\n]*$/ ) { # Base64, not a binary image
+      $data = decode_base64($data);
+   }
+   my($out, $t, $off) = ("", 0, 0);
+   my($left) = scalar(keys(%{$dup{$drv} || {}}));
+   while( $off < length($data) || $left > 0 ) {
+      if( exists($dup{$drv}{$t}) ) {
+         my($rd, $rt) = @{$dup{$drv}{$t}};
+         my($src) = ($rd == $drv) ? $out : $img{$rd}; # Earlier on this pack?
+         die "$f: track $t refers to rl$rd track $rt, not rebuilt yet\n"
+            if( !defined($src) || ($rt+1)*$TRACK > length($src) );
+         $out .= substr($src, $rt*$TRACK, $TRACK);
+         $left--;
+      } else {
+         die "$f: ends inside track $t\n" if( $off + $TRACK > length($data) );
+         $out .= substr($data, $off, $TRACK);
+         $off += $TRACK;
+      }
+      $t++;
+   }
+   $img{$drv} = $out;
+   (my $dsk = $f) =~ s/\.[^.\/]*$//;
+   $dsk .= ".dsk";
+   open(O, ">", $dsk) || die "$dsk: $!\n";
+   binmode(O);
+   print O $out;
+   close(O);
+   printf("%s: %d tracks, %d from other tracks\n", $dsk, $t,
+          scalar(keys(%{$dup{$drv} || {}})));
+}
@@ -0,0 +1,73 @@
+#!/usr/bin/perl
+#
+# Host side of the RLINCR incremental backup.
+#
+#  rlinc.pl crc old.dsk > rl0.crc
+#     Make the track CRC manifest of the last backup, send it to ek first.
+#
+#  rlinc.pl merge old.dsk rl0.idx rl0.inc > new.dsk
+#     Put the changed tracks ek sent back over the old image. rl0.inc may
+#     be binary (BINARYSAFE build) or base64.
+
+use MIME::Base64;
+
+my($TRACK) = 40*256; # 40 sectors of 256 bytes
+
+sub crc16 { # CRC-16/CCITT, init 0xFFFF, same as rl_crc() in rl.c
+   my($crc, $data) = @_;
+   my($b, $i);
+   foreach $b (unpack("C*", $data)) {
+      $crc ^= ($b << 8);
+      for($i=0;$i<8;$i++) {
+         $crc = ($crc & 0x8000) ? (($crc << 1) ^ 0x1021) : ($crc << 1);
+         $crc &= 0xFFFF;
+      }
+   }
+   return($crc);
+}
+
+sub slurp {
+   my($f) = @_;
+   my($d);
+   open(F, "<", $f) || die "$f: $!\n";
+   binmode(F);
+   local $/;
+   $d = <F>;
+   close(F);
+   return($d);
+}
+
+my($cmd) = shift(@ARGV);
+binmode(STDOUT);
+
+if( $cmd eq "crc" && @ARGV == 1 ) {
+   my($img) = slurp($ARGV[0]);
+   my($t);
+   for($t=0;($t+1)*$TRACK<=length($img);$t++) {
+      printf("%04x\n", crc16(0xFFFF, substr($img, $t*$TRACK, $TRACK)));
+   }
+} elsif( $cmd eq "merge" && @ARGV == 3 ) {
+   my($img) = slurp($ARGV[0]);
+   my(@trk, $l);
+   open(I, "<", $ARGV[1]) || die "$ARGV[1]: $!\n";
+   while( ($l=<I>) ) {
+      if( $l =~ /cyl\s+(\d+)\s+head\s+(\d+)/ ) {
+         push(@trk, $1*2 + $2);
+      }
+   }
+   close(I);
+   my($inc) = slurp($ARGV[2]);
+   if( length($inc) != @trk * $TRACK ) { # Not binary, must be base64
+      $inc = decode_base64($inc);
+   }
+   die "rl.inc holds ".length($inc)." bytes, rl.idx lists ".scalar(@trk).
+       " tracks\n" if( length($inc) != @trk * $TRACK );
+   my($i);
+   for($i=0;$i<@trk;$i++) {
+      substr($img, $trk[$i]*$TRACK, $TRACK) = substr($inc, $i*$TRACK, $TRACK);
+   }
+   print $img;
+} else {
+   die "usage: rlinc.pl crc old.dsk > rl0.crc\n".
+       "       rlinc.pl merge old.dsk rl0.idx rl0.inc > new.dsk\n";
+}
@@ -0,0 +1,62 @@
+#!/usr/bin/perl
+#
+# Host side of the allocation aware backup (RLV7, RLRT11, RLRSTS).
+#
+#  rlmap.pl rl0.map rl0.blk > rl0.dsk
+#     Rebuild the block exact pack image. rl0.map starts with a "format"
+#     line, then has a bit per 512 byte block, bit n is (1 << (n & 7)) of
+#     byte n/8 in hex, set for the blocks rl0.blk holds in order. The others
+#     were free in the file system and come back zeroed. rl0.blk may be
+#     binary (BINARYSAFE build) or base64.
+
+use MIME::Base64;
+
+my($BLOCK) = 512;
+
+sub slurp {
+   my($f) = @_;
+   my($d);
+   open(F, "<", $f) || die "$f: $!\n";
+   binmode(F);
+   local $/;
+   $d = <F>;
+   close(F);
+   return($d);
+}
+
+die "usage: rlmap.pl rl0.map rl0.blk > rl0.dsk\n" if( @ARGV != 2 );
+
+my($map, $fmt, $l) = ("", "none");
+open(M, "<", $ARGV[0]) || die "$ARGV[0]: $!\n";
+while( ($l=<M>) ) {
+   if( $l =~ /^format\s+(\S+)/ ) {
+      $fmt = $1;
+   } elsif( $l =~ /^([0-9a-fA-F]+)\s*$/ ) {
+      $map .= $1;
+   }
+}
+close(M);
+$map = pack("H*", $map);
+my($nblk) = length($map) * 8;
+my($sent) = unpack("%32b*", $map);
+
+my($data) = slurp($ARGV[1]);
+if( length($data) != $sent * $BLOCK ) { # Not binary, must be base64
+   $data = decode_base64($data);
+   $data = substr($data, 0, $sent * $BLOCK); # Drop the padding
+}
+die "$ARGV[1] holds ".length($data)." bytes, $ARGV[0] lists $sent blocks\n"
+   if( length($data) != $sent * $BLOCK );
+
+binmode(STDOUT);
+my($b, $off, $zero) = (0, 0, "\0" x $BLOCK);
+for($b=0;$b<$nblk;$b++) {
+   if( vec($map, $b, 1) ) {
+      print substr($data, $off, $BLOCK);
+      $off += $BLOCK;
+   } else {
+      print $zero;
+   }
+}
+printf(STDERR "%s: %d blocks, %d sent, %d free zeroed\n", $fmt, $nblk,
+       $sent, $nblk - $sent);